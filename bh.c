@@ -6,28 +6,82 @@
  * Copyright (c) 2010, ST-Ericsson
  */
 #include <linux/gpio/consumer.h>
+#include <linux/kthread.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
 #include <net/mac80211.h>
+#include <net/page_pool.h>
 
 #include "bh.h"
 #include "wfx.h"
 #include "hwio.h"
 #include "traces.h"
 #include "hif_rx.h"
+#include "data_rx.h"
+#include "data_tx.h"
 #include "hif_api_cmd.h"
 
+/* Number of pages kept by the Rx pool */
+#define WFX_RX_POOL_SIZE 256
+#define WFX_RX_HEADROOM NET_SKB_PAD
+
+/* The bh runs either from the workqueue or from the dedicated thread (see bh_thread_start()) */
+static void bh_queue(struct wfx_dev *wdev)
+{
+	struct wfx_hif *hif = &wdev->hif;
+
+	/* Keep the date of the oldest request */
+	atomic64_cmpxchg(&hif->sched_queued, 0, ktime_get_ns());
+	if (hif->worker)
+		kthread_queue_work(hif->worker, &hif->bh_kwork);
+	else
+		queue_work(wdev->bh_wq, &hif->bh);
+}
+
+static bool bh_is_pending(struct wfx_dev *wdev)
+{
+	if (wdev->hif.worker)
+		return !list_empty(&wdev->hif.bh_kwork.node);
+	return work_pending(&wdev->hif.bh);
+}
+
+static void bh_flush(struct wfx_dev *wdev)
+{
+	if (wdev->hif.worker)
+		kthread_flush_work(&wdev->hif.bh_kwork);
+	flush_work(&wdev->hif.bh);
+}
+
+static void device_wakeup_stats(struct wfx_dev *wdev, ktime_t start)
+{
+	struct wfx_hif *hif = &wdev->hif;
+	s64 delay = ktime_us_delta(ktime_get(), start);
+
+	hif->wakeup_count++;
+	hif->wakeup_total_us += delay;
+	if (delay > hif->wakeup_max_us)
+		hif->wakeup_max_us = delay;
+}
+
 static void device_wakeup(struct wfx_dev *wdev)
 {
 	int max_retry = 3;
+	ktime_t start;
 
 	if (!wdev->pdata.gpio_wakeup)
 		return;
+	/* The release is postponed by keep_awake_ms */
+	if (cancel_delayed_work(&wdev->hif.release_work))
+		wdev->hif.wakeup_saved++;
 	if (gpiod_get_value_cansleep(wdev->pdata.gpio_wakeup) > 0)
 		return;
 
+	start = ktime_get();
 	if (wfx_api_older_than(wdev, 1, 4)) {
 		gpiod_set_value_cansleep(wdev->pdata.gpio_wakeup, 1);
 		if (!completion_done(&wdev->hif.ctrl_ready))
 			usleep_range(2000, 2500);
+		device_wakeup_stats(wdev, start);
 		return;
 	}
 	for (;;) {
@@ -37,12 +91,14 @@ static void device_wakeup(struct wfx_dev *wdev)
 		 */
 		if (wait_for_completion_timeout(&wdev->hif.ctrl_ready, msecs_to_jiffies(2))) {
 			complete(&wdev->hif.ctrl_ready);
+			device_wakeup_stats(wdev, start);
 			return;
 		} else if (max_retry-- > 0) {
 			/* Older firmwares have a race in sleep/wake-up process.  Redo the process
 			 * is sufficient to unfreeze the chip.
 			 */
 			dev_err(wdev->dev, "timeout while wake up chip\n");
+			wdev->hif.wakeup_retries++;
 			gpiod_set_value_cansleep(wdev->pdata.gpio_wakeup, 0);
 			usleep_range(2000, 2500);
 		} else {
@@ -54,36 +110,146 @@ static void device_wakeup(struct wfx_dev *wdev)
 
 static void device_release(struct wfx_dev *wdev)
 {
+	unsigned int keep_awake_ms = READ_ONCE(wdev->keep_awake_ms);
+
 	if (!wdev->pdata.gpio_wakeup)
 		return;
 
+	/* Traffic often comes by bursts. Keeping the chip awake a bit longer avoids to pay the
+	 * wake-up delay for each burst.
+	 */
+	if (keep_awake_ms) {
+		queue_delayed_work(wdev->bh_wq, &wdev->hif.release_work,
+				   msecs_to_jiffies(keep_awake_ms));
+		return;
+	}
 	gpiod_set_value_cansleep(wdev->pdata.gpio_wakeup, 0);
 }
 
+static void device_release_work(struct work_struct *work)
+{
+	struct wfx_dev *wdev = container_of(to_delayed_work(work), struct wfx_dev,
+					    hif.release_work);
+
+	mutex_lock(&wdev->hif.bh_lock);
+	/* The bh may have woken up the chip meanwhile */
+	if (!wdev->hif.tx_buffers_used && !bh_is_pending(wdev) &&
+	    !delayed_work_pending(&wdev->hif.release_work))
+		gpiod_set_value_cansleep(wdev->pdata.gpio_wakeup, 0);
+	mutex_unlock(&wdev->hif.bh_lock);
+}
+
+#if IS_ENABLED(CONFIG_PAGE_POOL)
+static int wfx_rx_pool_init(struct wfx_dev *wdev)
+{
+	struct page_pool_params pp_params = {
+		.order = 0,
+		.pool_size = WFX_RX_POOL_SIZE,
+		.nid = NUMA_NO_NODE,
+		.dev = wdev->dev,
+	};
+
+	wdev->hif.rx_pool = page_pool_create(&pp_params);
+	if (IS_ERR(wdev->hif.rx_pool)) {
+		wdev->hif.rx_pool = NULL;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void wfx_rx_pool_destroy(struct wfx_dev *wdev)
+{
+	page_pool_destroy(wdev->hif.rx_pool);
+	wdev->hif.rx_pool = NULL;
+}
+
+/* Return NULL if the message does not fit in a page with the room needed by build_skb() */
+static struct page *wfx_rx_page_alloc(struct wfx_dev *wdev, size_t len)
+{
+	if (!wdev->hif.rx_pool)
+		return NULL;
+	if (WFX_RX_HEADROOM + len + SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) > PAGE_SIZE)
+		return NULL;
+	return page_pool_dev_alloc_pages(wdev->hif.rx_pool);
+}
+
+static void wfx_rx_page_free(struct wfx_dev *wdev, struct page *page)
+{
+	page_pool_put_full_page(wdev->hif.rx_pool, page, false);
+}
+
+static struct sk_buff *wfx_rx_page_build_skb(struct wfx_dev *wdev, struct page *page)
+{
+	struct sk_buff *skb = build_skb(page_address(page), PAGE_SIZE);
+
+	if (!skb)
+		return NULL;
+	skb_reserve(skb, WFX_RX_HEADROOM);
+	skb_mark_for_recycle(skb);
+	return skb;
+}
+#else
+static int wfx_rx_pool_init(struct wfx_dev *wdev)
+{
+	return -EOPNOTSUPP;
+}
+
+static void wfx_rx_pool_destroy(struct wfx_dev *wdev)
+{
+}
+
+static struct page *wfx_rx_page_alloc(struct wfx_dev *wdev, size_t len)
+{
+	return NULL;
+}
+
+static void wfx_rx_page_free(struct wfx_dev *wdev, struct page *page)
+{
+}
+
+static struct sk_buff *wfx_rx_page_build_skb(struct wfx_dev *wdev, struct page *page)
+{
+	return NULL;
+}
+#endif
+
+/* The messages are read into pages of the Rx pool. The received frames are passed to mac80211 in
+ * skbs built around these pages. The other messages are handled directly from the page, which is
+ * recycled immediately. The messages too large for a page are read into a skb.
+ */
 static int rx_helper(struct wfx_dev *wdev, size_t read_len, int *is_cnf)
 {
-	struct sk_buff *skb;
+	struct sk_buff *skb = NULL;
+	struct page *page;
 	struct wfx_hif_msg *hif;
 	size_t alloc_len;
 	size_t computed_len;
 	int release_count;
 	int piggyback = 0;
+	void *buf;
 
 	WARN(read_len > round_down(0xFFF, 2) * sizeof(u16), "request exceed the chip capability");
 
 	/* Add 2 to take into account piggyback size */
 	alloc_len = wdev->hwbus_ops->align_size(wdev->hwbus_priv, read_len + 2);
-	skb = dev_alloc_skb(alloc_len);
-	if (!skb)
-		return -ENOMEM;
+	page = wfx_rx_page_alloc(wdev, alloc_len);
+	if (page) {
+		buf = page_address(page) + WFX_RX_HEADROOM;
+	} else {
+		wdev->hif.rx_skb_fallbacks++;
+		skb = dev_alloc_skb(alloc_len);
+		if (!skb)
+			return -ENOMEM;
+		buf = skb->data;
+	}
 
-	if (wfx_data_read(wdev, skb->data, alloc_len))
+	if (wfx_data_read(wdev, buf, alloc_len))
 		goto err;
 
-	piggyback = le16_to_cpup((__le16 *)(skb->data + alloc_len - 2));
+	piggyback = le16_to_cpup((__le16 *)(buf + alloc_len - 2));
 	_trace_piggyback(piggyback, false);
 
-	hif = (struct wfx_hif_msg *)skb->data;
+	hif = buf;
 	WARN(hif->encrypted & 0x3, "encryption is unsupported");
 	if (WARN(read_len < sizeof(struct wfx_hif_msg), "corrupted read"))
 		goto err;
@@ -116,9 +282,21 @@ static int rx_helper(struct wfx_dev *wdev, size_t read_len, int *is_cnf)
 		wdev->hif.rx_seqnum = (hif->seqnum + 1) % (HIF_COUNTER_MAX + 1);
 	}
 
-	skb_put(skb, le16_to_cpu(hif->len));
-	/* wfx_handle_rx takes care on SKB livetime */
-	wfx_handle_rx(wdev, skb);
+	if (page && hif->id == HIF_IND_ID_RX) {
+		skb = wfx_rx_page_build_skb(wdev, page);
+		if (!skb)
+			goto err;
+		page = NULL;
+	}
+	if (skb) {
+		skb_put(skb, le16_to_cpu(hif->len));
+		/* wfx_handle_rx takes care on SKB livetime */
+		wfx_handle_rx(wdev, skb);
+	} else {
+		wdev->hif.rx_msgs_no_skb++;
+		wfx_handle_rx_msg(wdev, hif);
+		wfx_rx_page_free(wdev, page);
+	}
 	if (!wdev->hif.tx_buffers_used)
 		wake_up(&wdev->hif.tx_buffers_empty);
 
@@ -127,6 +305,8 @@ static int rx_helper(struct wfx_dev *wdev, size_t read_len, int *is_cnf)
 err:
 	if (skb)
 		dev_kfree_skb(skb);
+	if (page)
+		wfx_rx_page_free(wdev, page);
 	return -EIO;
 }
 
@@ -195,22 +375,34 @@ end:
 
 static int bh_work_tx(struct wfx_dev *wdev, int max_msg)
 {
-	struct wfx_hif_msg *hif;
-	int i;
+	struct wfx_hif_msg *batch[WFX_TX_BATCH_MAX];
+	struct wfx_hif_cmd_req *req;
+	int i = 0, j, num_bufs, num_frames;
 
-	for (i = 0; i < max_msg; i++) {
-		hif = NULL;
-		if (wdev->hif.tx_buffers_used < le16_to_cpu(wdev->hw_caps.num_inp_ch_bufs)) {
-			if (try_wait_for_completion(&wdev->hif_cmd.ready)) {
-				WARN(!mutex_is_locked(&wdev->hif_cmd.lock), "data locking error");
-				hif = wdev->hif_cmd.buf_send;
-			} else {
-				hif = wfx_tx_queues_get(wdev);
-			}
+	while (i < max_msg) {
+		num_bufs = le16_to_cpu(wdev->hw_caps.num_inp_ch_bufs) - wdev->hif.tx_buffers_used;
+		if (num_bufs <= 0)
+			break;
+		/* Requests have priority over the data */
+		req = wfx_cmd_get_next(wdev);
+		if (req) {
+			tx_helper(wdev, req->buf_send);
+			/* Without reply, the request may be released as soon as it is sent */
+			if (req->no_reply)
+				wfx_data_flush(wdev);
+			wfx_cmd_sent(wdev, req);
+			i++;
+			continue;
 		}
-		if (!hif)
-			return i;
-		tx_helper(wdev, hif);
+		wfx_tx_pull_txqs(wdev);
+		/* Frames are retrieved by batches to limit the locking overhead */
+		num_frames = min3(num_bufs, max_msg - i, (int)ARRAY_SIZE(batch));
+		num_frames = wfx_tx_queues_get(wdev, batch, num_frames);
+		if (!num_frames)
+			break;
+		for (j = 0; j < num_frames; j++)
+			tx_helper(wdev, batch[j]);
+		i += num_frames;
 	}
 	return i;
 }
@@ -230,57 +422,396 @@ static void ack_sdio_data(struct wfx_dev *wdev)
 	}
 }
 
-static void bh_work(struct work_struct *work)
+#define WFX_BH_BUDGET_MIN 4
+#define WFX_BH_BUDGET_DEFAULT 32
+#define WFX_BH_BUDGET_MAX 64
+
+/* Split the work between Tx and Rx for the next iteration of the bh:
+ *   - it is useless to send more messages than the chip can accept
+ *   - if an Rx message is already waiting, do not let it wait behind a long Tx burst
+ *   - if the chip is short of buffers, read the confirmations first since they release them
+ *   - if the Tx queues are filling while the chip has room, do not let the Rx starve them
+ */
+static void bh_get_budgets(struct wfx_dev *wdev, int *max_tx, int *max_rx)
+{
+	int num_bufs = le16_to_cpu(wdev->hw_caps.num_inp_ch_bufs);
+	int free_bufs = num_bufs - wdev->hif.tx_buffers_used;
+	int rx_pending = atomic_read(&wdev->hif.ctrl_reg) & CTRL_NEXT_LEN_MASK;
+
+	*max_tx = clamp(free_bufs, WFX_BH_BUDGET_MIN, WFX_BH_BUDGET_MAX);
+	if (rx_pending)
+		*max_tx = min(*max_tx, max(num_bufs / 2, WFX_BH_BUDGET_MIN));
+
+	if (free_bufs < num_bufs / 4)
+		*max_rx = WFX_BH_BUDGET_MAX;
+	else if (wfx_tx_queues_get_backlog(wdev) > free_bufs)
+		*max_rx = max(num_bufs / 2, WFX_BH_BUDGET_MIN);
+	else
+		*max_rx = WFX_BH_BUDGET_DEFAULT;
+}
+
+static void bh_hist_add(unsigned int *hist, int val)
+{
+	hist[min(fls(val), WFX_BH_HIST_BUCKETS - 1)]++;
+}
+
+/* Owner of the control register when busy-poll is enabled */
+enum {
+	WFX_BH_POLL_OFF,
+	WFX_BH_POLL_IRQ_READ, /* the IRQ handler is reading the control register */
+	WFX_BH_POLL_OWNED, /* the bh (or the rescue work) is polling the control register */
+	WFX_BH_POLL_DEFERRED, /* same, but an IRQ has been received meanwhile */
+};
+
+#define WFX_BH_POLL_MIN_US 20
+#define WFX_BH_POLL_RESCUE_MS 10
+
+static void wfx_bh_set_ctrl_reg(struct wfx_dev *wdev, u32 cur)
+{
+	u32 prev;
+
+	prev = atomic_xchg(&wdev->hif.ctrl_reg, cur);
+	complete(&wdev->hif.ctrl_ready);
+	if (prev != 0)
+		dev_err(wdev->dev, "received IRQ but previous data was not (yet) read: %04x/%04x\n",
+			prev, cur);
+}
+
+/* As explained in wfx_bh_poll_irq(), the device may lose an IRQ raised while the host reads the
+ * control register. So, the IRQ handler and the busy-poll must not read the control register
+ * concurrently. While the bh owns the control register, the IRQ handler only reports the IRQ to the
+ * bh.
+ *
+ * Return true if the IRQ has been deferred to the bh. Else, the caller owns the control register
+ * until wfx_bh_read_ctrl_reg() returns.
+ */
+static bool bh_poll_defer_irq(struct wfx_dev *wdev)
+{
+	struct wfx_hif *hif = &wdev->hif;
+	int old;
+
+	if (!wdev->bh_poll_max_us)
+		return false;
+	for (;;) {
+		old = atomic_cmpxchg(&hif->poll_state, WFX_BH_POLL_OFF, WFX_BH_POLL_IRQ_READ);
+		if (old == WFX_BH_POLL_OFF)
+			return false;
+		if (old == WFX_BH_POLL_DEFERRED ||
+		    atomic_cmpxchg(&hif->poll_state, WFX_BH_POLL_OWNED,
+				   WFX_BH_POLL_DEFERRED) == WFX_BH_POLL_OWNED) {
+			hif->poll_deferred_irqs++;
+			return true;
+		}
+	}
+}
+
+/* Return false if an IRQ has been deferred meanwhile. Then, the control register must be read
+ * again.
+ */
+static bool bh_poll_release(struct wfx_dev *wdev)
+{
+	return atomic_cmpxchg(&wdev->hif.poll_state, WFX_BH_POLL_OWNED,
+			      WFX_BH_POLL_OFF) == WFX_BH_POLL_OWNED;
+}
+
+/* An event arrived delay_us after the end of the bh. Make sure the next windows would catch it. */
+static void bh_poll_grow(struct wfx_dev *wdev, s64 delay_us)
+{
+	unsigned int max_us = wdev->bh_poll_max_us;
+	unsigned int window_us;
+
+	if (delay_us > max_us)
+		return;
+	window_us = clamp_t(s64, delay_us * 2, WFX_BH_POLL_MIN_US, max_us);
+	if (window_us > READ_ONCE(wdev->hif.poll_window_us))
+		WRITE_ONCE(wdev->hif.poll_window_us, window_us);
+}
+
+static void bh_poll_shrink(struct wfx_dev *wdev)
+{
+	unsigned int window_us = wdev->hif.poll_window_us / 2;
+
+	if (window_us < WFX_BH_POLL_MIN_US)
+		window_us = 0;
+	WRITE_ONCE(wdev->hif.poll_window_us, window_us);
+}
+
+/* Once the bh has drained, keep reading the control register instead of waiting for the next IRQ.
+ * The duration of the window follows the traffic: it grows when events arrive shortly after the bh
+ * and shrinks on each unfruitful poll. Return true if an event is available.
+ *
+ * The bh keeps the ownership of the control register until it leaves the poll mode. Since the last
+ * read may still have masked an IRQ, a rescue read is scheduled a bit later.
+ */
+static bool bh_busy_poll(struct wfx_dev *wdev)
+{
+	struct wfx_hif *hif = &wdev->hif;
+	ktime_t start, now;
+	u32 reg;
+
+	if (!wdev->bh_poll_max_us || wdev->poll_irq)
+		return false;
+	if (atomic_read(&hif->poll_state) == WFX_BH_POLL_OFF) {
+		if (!READ_ONCE(hif->poll_window_us) || bh_is_pending(wdev))
+			return false;
+		if (atomic_cmpxchg(&hif->poll_state, WFX_BH_POLL_OFF,
+				   WFX_BH_POLL_OWNED) != WFX_BH_POLL_OFF)
+			return false;
+	}
+	start = ktime_get();
+	do {
+		do {
+			/* A deferred IRQ is consumed by the read below */
+			atomic_set(&hif->poll_state, WFX_BH_POLL_OWNED);
+			wfx_control_reg_read(wdev, &reg);
+			now = ktime_get();
+			if (reg & CTRL_NEXT_LEN_MASK) {
+				hif->poll_hits++;
+				bh_poll_grow(wdev, ktime_us_delta(now, start));
+				wfx_bh_set_ctrl_reg(wdev, reg);
+				return true;
+			}
+			wfx_bus_session_yield(wdev);
+			cpu_relax();
+		} while (ktime_us_delta(now, start) < READ_ONCE(hif->poll_window_us) &&
+			 !bh_is_pending(wdev));
+	} while (!bh_poll_release(wdev));
+	/* A Tx request is not a reason to shorten the window */
+	if (!bh_is_pending(wdev)) {
+		hif->poll_misses++;
+		bh_poll_shrink(wdev);
+	}
+	mod_delayed_work(wdev->bh_wq, &hif->poll_rescue, msecs_to_jiffies(WFX_BH_POLL_RESCUE_MS));
+	return false;
+}
+
+static void bh_poll_rescue_work(struct work_struct *work)
+{
+	struct wfx_dev *wdev = container_of(to_delayed_work(work), struct wfx_dev, hif.poll_rescue);
+	struct wfx_hif *hif = &wdev->hif;
+	bool found = false;
+	u32 reg;
+
+	mutex_lock(&hif->bh_lock);
+	/* An IRQ has been received since the end of the poll or the bh is polling again */
+	if (atomic_read(&hif->ctrl_reg) ||
+	    atomic_cmpxchg(&hif->poll_state, WFX_BH_POLL_OFF,
+			   WFX_BH_POLL_OWNED) != WFX_BH_POLL_OFF) {
+		mutex_unlock(&hif->bh_lock);
+		return;
+	}
+	do {
+		atomic_set(&hif->poll_state, WFX_BH_POLL_OWNED);
+		wfx_control_reg_read(wdev, &reg);
+		if (reg & CTRL_NEXT_LEN_MASK) {
+			hif->poll_rescued++;
+			wfx_bh_set_ctrl_reg(wdev, reg);
+			found = true;
+			/* The bh will take care of the next events */
+			atomic_set(&hif->poll_state, WFX_BH_POLL_OFF);
+			break;
+		}
+	} while (!bh_poll_release(wdev));
+	mutex_unlock(&hif->bh_lock);
+	if (found)
+		bh_queue(wdev);
+}
+
+static void bh_run(struct wfx_dev *wdev)
 {
-	struct wfx_dev *wdev = container_of(work, struct wfx_dev, hif.bh);
 	int stats_req = 0, stats_cnf = 0, stats_ind = 0;
 	bool release_chip = false, last_op_is_rx = false;
-	int num_tx, num_rx;
+	int num_tx, num_rx, max_tx, max_rx, num_loops = 0;
 
 	device_wakeup(wdev);
+	/* device_wakeup() waits for an IRQ, so the session can only start after it */
+	wfx_bus_session_start(wdev);
 	do {
-		num_tx = bh_work_tx(wdev, 32);
+		wfx_bus_session_yield(wdev);
+		bh_get_budgets(wdev, &max_tx, &max_rx);
+		num_tx = bh_work_tx(wdev, max_tx);
 		stats_req += num_tx;
 		if (num_tx)
 			last_op_is_rx = false;
-		num_rx = bh_work_rx(wdev, 32, &stats_cnf);
+		num_rx = bh_work_rx(wdev, max_rx, &stats_cnf);
 		stats_ind += num_rx;
-		if (num_rx)
+		if (num_rx) {
 			last_op_is_rx = true;
-	} while (num_rx || num_tx);
+			wfx_rx_napi_schedule(wdev);
+		}
+		_trace_bh_loop(max_tx, max_rx, num_tx, num_rx);
+		bh_hist_add(wdev->hif.hist_msgs_per_loop, num_tx + num_rx);
+		num_loops++;
+	} while (num_rx || num_tx || bh_busy_poll(wdev));
+	bh_hist_add(wdev->hif.hist_loops_per_run, num_loops);
 	stats_ind -= stats_cnf;
 
 	if (last_op_is_rx)
 		ack_sdio_data(wdev);
-	if (!wdev->hif.tx_buffers_used && !work_pending(work)) {
+	/* The chip must not go to sleep during a transfer */
+	wfx_data_flush(wdev);
+	wfx_bus_session_end(wdev);
+	if (!wdev->hif.tx_buffers_used && !bh_is_pending(wdev)) {
 		device_release(wdev);
 		release_chip = true;
 	}
+	if (wdev->bh_poll_max_us)
+		wdev->hif.poll_last_end = ktime_get();
 	_trace_bh_stats(stats_ind, stats_req, stats_cnf, wdev->hif.tx_buffers_used, release_chip);
 }
 
-/* An IRQ from chip did occur */
-void wfx_bh_request_rx(struct wfx_dev *wdev)
+static void bh_sched_stats(struct wfx_dev *wdev)
 {
-	u32 cur, prev;
+	struct wfx_hif *hif = &wdev->hif;
+	s64 queued = atomic64_xchg(&hif->sched_queued, 0);
+	s64 delay;
 
-	wfx_control_reg_read(wdev, &cur);
-	prev = atomic_xchg(&wdev->hif.ctrl_reg, cur);
-	complete(&wdev->hif.ctrl_ready);
-	queue_work(wdev->bh_wq, &wdev->hif.bh);
+	/* The bh has been started by another way than bh_queue() */
+	if (!queued)
+		return;
+	delay = div_s64(ktime_get_ns() - queued, NSEC_PER_USEC);
+	hif->sched_count++;
+	hif->sched_total_us += delay;
+	if (delay > hif->sched_max_us)
+		hif->sched_max_us = delay;
+}
+
+static void bh_work(struct work_struct *work)
+{
+	struct wfx_dev *wdev = container_of(work, struct wfx_dev, hif.bh);
+
+	mutex_lock(&wdev->hif.bh_lock);
+	bh_sched_stats(wdev);
+	bh_run(wdev);
+	mutex_unlock(&wdev->hif.bh_lock);
+}
 
-	if (!(cur & CTRL_NEXT_LEN_MASK))
+static void bh_kwork(struct kthread_work *work)
+{
+	struct wfx_dev *wdev = container_of(work, struct wfx_dev, hif.bh_kwork);
+
+	mutex_lock(&wdev->hif.bh_lock);
+	bh_sched_stats(wdev);
+	bh_run(wdev);
+	mutex_unlock(&wdev->hif.bh_lock);
+}
+
+static int bh_thread_set_affinity(struct wfx_dev *wdev, struct task_struct *task)
+{
+	cpumask_var_t cpus;
+	int ret;
+
+	if (!wdev->bh_thread_cpus || !*wdev->bh_thread_cpus)
+		return 0;
+	if (!zalloc_cpumask_var(&cpus, GFP_KERNEL))
+		return -ENOMEM;
+	ret = cpulist_parse(wdev->bh_thread_cpus, cpus);
+	if (!ret && !cpumask_intersects(cpus, cpu_online_mask))
+		ret = -EINVAL;
+	if (!ret)
+		ret = set_cpus_allowed_ptr(task, cpus);
+	free_cpumask_var(cpus);
+	return ret;
+}
+
+/* Modules cannot choose an arbitrary real-time priority. sched_set_fifo() and
+ * sched_set_fifo_low() are the only options. The priority can still be changed from userspace.
+ */
+static int bh_thread_set_policy(struct wfx_dev *wdev, struct task_struct *task)
+{
+	const char *policy = wdev->bh_thread_policy;
+
+	if (!policy || !*policy || sysfs_streq(policy, "normal"))
+		sched_set_normal(task, wdev->bh_thread_nice);
+	else if (sysfs_streq(policy, "fifo"))
+		sched_set_fifo(task);
+	else if (sysfs_streq(policy, "fifo_low"))
+		sched_set_fifo_low(task);
+	else
+		return -EINVAL;
+	return 0;
+}
+
+/* A dedicated thread allows to choose the scheduling policy and the CPUs of the bh. On failure,
+ * the bh keeps using the workqueue.
+ */
+static void bh_thread_start(struct wfx_dev *wdev)
+{
+	struct kthread_worker *worker;
+
+	kthread_init_work(&wdev->hif.bh_kwork, bh_kwork);
+	if (!wdev->bh_thread)
+		return;
+	worker = kthread_create_worker(0, "wfx_bh/%s", dev_name(wdev->dev));
+	if (IS_ERR(worker)) {
+		dev_warn(wdev->dev, "cannot create the bh thread: %pe\n", worker);
+		return;
+	}
+	if (bh_thread_set_policy(wdev, worker->task))
+		dev_warn(wdev->dev, "invalid bh thread policy: %s\n", wdev->bh_thread_policy);
+	if (bh_thread_set_affinity(wdev, worker->task))
+		dev_warn(wdev->dev, "invalid bh thread CPU list: %s\n", wdev->bh_thread_cpus);
+	wdev->hif.worker = worker;
+}
+
+static void bh_thread_stop(struct wfx_dev *wdev)
+{
+	if (!wdev->hif.worker)
+		return;
+	kthread_destroy_worker(wdev->hif.worker);
+	wdev->hif.worker = NULL;
+}
+
+static void wfx_bh_read_ctrl_reg(struct wfx_dev *wdev)
+{
+	u32 cur;
+
+	wfx_control_reg_read(wdev, &cur);
+	/* With busy-poll, the IRQ may be received after the bh already read the data */
+	if (!(cur & CTRL_NEXT_LEN_MASK) && !wdev->bh_poll_max_us)
 		dev_err(wdev->dev, "unexpected control register value: length field is 0: %04x\n",
 			cur);
-	if (prev != 0)
-		dev_err(wdev->dev, "received IRQ but previous data was not (yet) read: %04x/%04x\n",
-			prev, cur);
+	wfx_bh_set_ctrl_reg(wdev, cur);
+	if (wdev->bh_poll_max_us) {
+		atomic_set(&wdev->hif.poll_state, WFX_BH_POLL_OFF);
+		bh_poll_grow(wdev, ktime_us_delta(ktime_get(), wdev->hif.poll_last_end));
+	}
+}
+
+/* An IRQ from chip did occur */
+void wfx_bh_request_rx(struct wfx_dev *wdev)
+{
+	if (bh_poll_defer_irq(wdev))
+		return;
+	wfx_bh_read_ctrl_reg(wdev);
+	bh_queue(wdev);
+}
+
+/* Same than wfx_bh_request_rx(), but the caller is allowed to sleep (threaded IRQ handler). With
+ * bh_in_irq, the bh runs directly in the caller context. If the bh is already running from the
+ * workqueue, let it handle the event.
+ */
+void wfx_bh_irq_thread(struct wfx_dev *wdev)
+{
+	if (!wdev->bh_in_irq) {
+		wfx_bh_request_rx(wdev);
+		return;
+	}
+	if (bh_poll_defer_irq(wdev))
+		return;
+	wfx_bh_read_ctrl_reg(wdev);
+	if (!mutex_trylock(&wdev->hif.bh_lock)) {
+		bh_queue(wdev);
+		return;
+	}
+	bh_run(wdev);
+	mutex_unlock(&wdev->hif.bh_lock);
 }
 
 /* Driver want to send data */
 void wfx_bh_request_tx(struct wfx_dev *wdev)
 {
-	queue_work(wdev->bh_wq, &wdev->hif.bh);
+	bh_queue(wdev);
 }
 
 /* If IRQ is not available, this function allow to manually poll the control register and simulate
@@ -296,6 +827,7 @@ void wfx_bh_poll_irq(struct wfx_dev *wdev)
 
 	WARN(!wdev->poll_irq, "unexpected IRQ polling can mask IRQ");
 	flush_workqueue(wdev->bh_wq);
+	bh_flush(wdev);
 	start = ktime_get();
 	for (;;) {
 		wfx_control_reg_read(wdev, &reg);
@@ -314,11 +846,24 @@ void wfx_bh_poll_irq(struct wfx_dev *wdev)
 void wfx_bh_register(struct wfx_dev *wdev)
 {
 	INIT_WORK(&wdev->hif.bh, bh_work);
+	bh_thread_start(wdev);
+	mutex_init(&wdev->hif.bh_lock);
+	INIT_DELAYED_WORK(&wdev->hif.poll_rescue, bh_poll_rescue_work);
+	INIT_DELAYED_WORK(&wdev->hif.release_work, device_release_work);
+	/* Without the pool, the messages are read into skbs */
+	if (wfx_rx_pool_init(wdev))
+		dev_dbg(wdev->dev, "Rx page pool is not available\n");
 	init_completion(&wdev->hif.ctrl_ready);
 	init_waitqueue_head(&wdev->hif.tx_buffers_empty);
 }
 
 void wfx_bh_unregister(struct wfx_dev *wdev)
 {
-	flush_work(&wdev->hif.bh);
+	bh_flush(wdev);
+	/* The rescue work may have queued the bh again */
+	cancel_delayed_work_sync(&wdev->hif.poll_rescue);
+	bh_flush(wdev);
+	cancel_delayed_work_sync(&wdev->hif.release_work);
+	bh_thread_stop(wdev);
+	wfx_rx_pool_destroy(wdev);
 }
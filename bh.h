@@ -12,22 +12,67 @@
 #include <linux/wait.h>
 #include <linux/completion.h>
 #include <linux/workqueue.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
 
 struct wfx_dev;
+struct page_pool;
+
+/* Bucket i counts the values lower than 2^i (and greater or equal to 2^(i-1)). The last bucket
+ * also contains the larger values.
+ */
+#define WFX_BH_HIST_BUCKETS 8
 
 struct wfx_hif {
 	struct work_struct bh;
+	/* Used instead of the workqueue with bh_thread */
+	struct kthread_worker *worker;
+	struct kthread_work bh_kwork;
+	/* Delay between the request of the bh and its execution */
+	atomic64_t sched_queued; /* in ns, 0 if the bh has not been requested */
+	unsigned int sched_count;
+	u64 sched_total_us;
+	s64 sched_max_us;
+	struct mutex bh_lock; /* the bh may run from the workqueue or from the IRQ thread */
 	struct completion ctrl_ready;
 	wait_queue_head_t tx_buffers_empty;
 	atomic_t ctrl_reg;
 	int rx_seqnum;
 	int tx_seqnum;
 	int tx_buffers_used;
+
+	/* Wake-up of the chip (see device_wakeup()) */
+	struct delayed_work release_work;
+	unsigned int wakeup_count;
+	unsigned int wakeup_saved; /* the chip was still awake thanks to keep_awake_ms */
+	unsigned int wakeup_retries;
+	u64 wakeup_total_us;
+	s64 wakeup_max_us;
+
+	struct page_pool *rx_pool;
+	unsigned int rx_skb_fallbacks;
+	unsigned int rx_msgs_no_skb;
+
+	/* Only updated by the bh */
+	unsigned int hist_msgs_per_loop[WFX_BH_HIST_BUCKETS];
+	unsigned int hist_loops_per_run[WFX_BH_HIST_BUCKETS];
+
+	/* Busy-poll of the control register once the bh has drained (see bh_busy_poll()) */
+	atomic_t poll_state;
+	unsigned int poll_window_us;
+	ktime_t poll_last_end;
+	struct delayed_work poll_rescue;
+	unsigned int poll_hits;
+	unsigned int poll_misses;
+	unsigned int poll_deferred_irqs;
+	unsigned int poll_rescued;
 };
 
 void wfx_bh_register(struct wfx_dev *wdev);
 void wfx_bh_unregister(struct wfx_dev *wdev);
 void wfx_bh_request_rx(struct wfx_dev *wdev);
+void wfx_bh_irq_thread(struct wfx_dev *wdev);
 void wfx_bh_request_tx(struct wfx_dev *wdev);
 void wfx_bh_poll_irq(struct wfx_dev *wdev);
 
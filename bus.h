@@ -10,6 +10,7 @@
 
 #include <linux/mmc/sdio_func.h>
 #include <linux/spi/spi.h>
+#include <linux/skbuff.h>
 
 #define WFX_REG_CONFIG        0x0
 #define WFX_REG_CONTROL       0x1
@@ -28,9 +29,25 @@ struct wfx_hwbus_ops {
 	void (*lock)(void *bus_priv);
 	void (*unlock)(void *bus_priv);
 	size_t (*align_size)(void *bus_priv, size_t size);
+	/* Optional. Called with the bus locked. */
+	int (*set_block_size)(void *bus_priv, unsigned int size);
+	unsigned int (*get_block_size)(void *bus_priv);
+	/* Optional. Wait for the end of the transfers started by copy_to_io(). */
+	int (*flush)(void *bus_priv);
 };
 
+/* The Tx frames are sent straight from the skb, including the padding added by align_size(). The
+ * padding is read from the skb_shared_info that follows the data, so it must not be larger.
+ */
+static inline bool wfx_bus_block_size_valid(unsigned int size)
+{
+	return size && size - 1 <= SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+}
+
 extern struct sdio_driver wfx_sdio_driver;
 extern struct spi_driver wfx_spi_driver;
 
+int wfx_emul_register(void);
+void wfx_emul_unregister(void);
+
 #endif
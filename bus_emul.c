@@ -0,0 +1,651 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Software emulation of the WF200 (loopback bus).
+ *
+ * Copyright (c) 2017-2020, Silicon Laboratories, Inc.
+ */
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/etherdevice.h>
+#include <linux/workqueue.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+
+#include "bus.h"
+#include "wfx.h"
+#include "hwio.h"
+#include "main.h"
+#include "bh.h"
+#include "hif_api_cmd.h"
+#include "hif_api_mib.h"
+
+/* This bus does not drive any hardware. It emulates the bootloader and the HIF protocol of the
+ * firmware well enough to run the whole driver (BH, Tx queues, confirmations, ...). Every request
+ * is confirmed as soon as it is written. Frames are never sent on the air, but they can be looped
+ * back as received frames.
+ *
+ * The firmware and PDS files are still requested by the driver, but their content is ignored.
+ */
+
+static unsigned int emul_devices = 1;
+module_param(emul_devices, uint, 0444);
+MODULE_PARM_DESC(emul_devices, "Number of emulated devices to instantiate (default: 1)");
+
+static unsigned int emul_bus_latency_us;
+module_param(emul_bus_latency_us, uint, 0644);
+MODULE_PARM_DESC(emul_bus_latency_us, "Duration of each emulated bus access in us (default: 0)");
+
+static unsigned int emul_num_bufs = 30;
+module_param(emul_num_bufs, uint, 0444);
+MODULE_PARM_DESC(emul_num_bufs, "Number of input buffers of emulated firmware (default: 30)");
+
+static bool emul_rx_loopback;
+module_param(emul_rx_loopback, bool, 0644);
+MODULE_PARM_DESC(emul_rx_loopback, "Report every transmitted frame as a received frame");
+
+static unsigned int emul_keyset = 0xC0;
+module_param(emul_keyset, uint, 0444);
+MODULE_PARM_DESC(emul_keyset, "Keyset reported by emulated bootloader (default: 0xC0)");
+
+/* Keep sync with definitions in fwio.c */
+#define WFX_DCA_PUT               0x0900C004
+#define WFX_DCA_GET               0x0900C008
+#define WFX_DCA_HOST_STATUS       0x0900C00C
+#define     HOST_READY                0x87654321
+#define     HOST_INFO_READ            0xA753BD99
+#define     HOST_UPLOAD_PENDING       0xABCDDCBA
+#define     HOST_UPLOAD_COMPLETE      0xD4C64A99
+#define     HOST_OK_TO_JUMP           0x174FC882
+#define WFX_DCA_NCP_STATUS        0x0900C010
+#define     NCP_NOT_READY             0x12345678
+#define     NCP_READY                 0x87654321
+#define     NCP_INFO_READY            0xBD53EF99
+#define     NCP_DOWNLOAD_PENDING      0xABCDDCBA
+#define     NCP_AUTH_OK               0xD4C64A99
+#define WFX_STATUS_INFO           0x0900C080
+#define WFX_BOOTLOADER_LABEL      0x0900C084
+#define WFX_PTE_INFO              0x0900C0C0
+#define     PTE_INFO_KEYSET_IDX       0x0D
+#define     PTE_INFO_SIZE             0x10
+
+#define EMUL_MAX_DEVICES    4
+#define EMUL_BUF_SIZE       1616 /* value of size_inp_ch_buf reported by real firmware */
+#define EMUL_MAX_OUT_MSG    256
+#define EMUL_CFG_DEVICE_ID  0x01000000 /* CFG_DEVICE_ID_MAJOR == 1 */
+
+static const struct wfx_platform_data pdata_emul = {
+	.file_fw = "wfx/wfm_wf200",
+	.file_pds = "wfx/wf200.pds",
+};
+
+struct wfx_emul_msg {
+	struct list_head link;
+	/* true once the length of this message has been reported to the host */
+	bool announced;
+	u8 buf[EMUL_BUF_SIZE] __aligned(4);
+};
+
+struct wfx_emul_priv {
+	struct platform_device *pdev;
+	struct wfx_dev *core;
+	struct mutex lock;
+	struct work_struct irq_work;
+	struct list_head out_queue;
+	int out_queue_len;
+	bool irq_enabled;
+	bool multi_tx_conf;
+	int bufs_used;
+	int seqnum;
+	u32 reg_config;
+	u32 reg_control;
+	u32 reg_base_addr;
+	u32 dca_put;
+	u32 ncp_status;
+	u8 mac_addr[2][ETH_ALEN];
+};
+
+static struct platform_device *wfx_emul_devs[EMUL_MAX_DEVICES];
+
+static void wfx_emul_bus_delay(void)
+{
+	unsigned int latency = READ_ONCE(emul_bus_latency_us);
+
+	if (latency)
+		fsleep(latency);
+}
+
+static size_t wfx_emul_msg_len(struct wfx_emul_msg *msg)
+{
+	struct wfx_hif_msg *hif = (struct wfx_hif_msg *)msg->buf;
+
+	return round_up(le16_to_cpu(hif->len), 2);
+}
+
+static struct wfx_emul_msg *wfx_emul_out_head(struct wfx_emul_priv *bus)
+{
+	return list_first_entry_or_null(&bus->out_queue, struct wfx_emul_msg, link);
+}
+
+/* Value of the control register (or of the piggyback) as seen by the host */
+static u32 wfx_emul_ctrl_reg(struct wfx_emul_priv *bus)
+{
+	struct wfx_emul_msg *msg = wfx_emul_out_head(bus);
+	u32 val = bus->reg_control & CTRL_WLAN_WAKEUP;
+
+	if (val)
+		val |= CTRL_WLAN_READY;
+	if (msg) {
+		msg->announced = true;
+		val |= wfx_emul_msg_len(msg) / 2;
+	}
+	return val;
+}
+
+static void *wfx_emul_push(struct wfx_emul_priv *bus, int if_id, u8 id, size_t body_len)
+{
+	struct wfx_emul_msg *msg;
+	struct wfx_hif_msg *hif;
+
+	if (WARN(sizeof(*hif) + body_len > EMUL_BUF_SIZE, "message too large"))
+		return NULL;
+	if (bus->out_queue_len >= EMUL_MAX_OUT_MSG) {
+		dev_warn_ratelimited(&bus->pdev->dev, "output queue full, drop message %02x\n", id);
+		return NULL;
+	}
+	msg = kmalloc(sizeof(*msg), GFP_KERNEL);
+	if (!msg)
+		return NULL;
+	msg->announced = false;
+	memset(msg->buf, 0, sizeof(*hif) + body_len);
+	hif = (struct wfx_hif_msg *)msg->buf;
+	hif->len = cpu_to_le16(sizeof(*hif) + body_len);
+	hif->id = id;
+	hif->interface = if_id;
+	hif->seqnum = bus->seqnum;
+	bus->seqnum = (bus->seqnum + 1) % (HIF_COUNTER_MAX + 1);
+
+	/* Like the real chip, only raise an IRQ if the host has nothing left to read */
+	if (list_empty(&bus->out_queue) && bus->irq_enabled)
+		queue_work(system_highpri_wq, &bus->irq_work);
+	list_add_tail(&msg->link, &bus->out_queue);
+	bus->out_queue_len++;
+	return hif->body;
+}
+
+static void wfx_emul_startup(struct wfx_emul_priv *bus)
+{
+	struct wfx_hif_ind_startup *body;
+
+	body = wfx_emul_push(bus, 2, HIF_IND_ID_STARTUP, sizeof(*body));
+	if (!body)
+		return;
+	body->num_inp_ch_bufs = cpu_to_le16(emul_num_bufs);
+	body->size_inp_ch_buf = cpu_to_le16(EMUL_BUF_SIZE);
+	body->num_links_ap = HIF_LINK_ID_MAX;
+	body->num_interfaces = 2;
+	memcpy(body->mac_addr, bus->mac_addr, sizeof(body->mac_addr));
+	body->api_version_major = 3;
+	body->api_version_minor = 12;
+	body->firmware_major = 3;
+	body->firmware_minor = 17;
+	body->firmware_build = 0;
+	body->supported_rate_mask = cpu_to_le32(0x003FFFCF);
+	strscpy(body->firmware_label, "WF200 emulator", sizeof(body->firmware_label));
+}
+
+static void wfx_emul_tx_confirm(struct wfx_emul_priv *bus, const struct wfx_hif_msg *hif)
+{
+	const struct wfx_hif_req_tx *req = (const struct wfx_hif_req_tx *)hif->body;
+	struct wfx_hif_cnf_multi_transmit *multi;
+	struct wfx_emul_msg *tail;
+	struct wfx_hif_msg *tail_hif;
+	struct wfx_hif_cnf_tx *cnf;
+	size_t len;
+
+	if (!bus->multi_tx_conf) {
+		cnf = wfx_emul_push(bus, hif->interface, HIF_CNF_ID_TX, sizeof(*cnf));
+		goto fill;
+	}
+	/* Append the confirmation to the last multi-transmit confirmation if the host does not know
+	 * about it yet
+	 */
+	tail = list_empty(&bus->out_queue) ? NULL :
+	       list_last_entry(&bus->out_queue, struct wfx_emul_msg, link);
+	tail_hif = tail ? (struct wfx_hif_msg *)tail->buf : NULL;
+	if (tail && !tail->announced && tail_hif->id == HIF_CNF_ID_MULTI_TRANSMIT &&
+	    tail_hif->interface == hif->interface) {
+		multi = (struct wfx_hif_cnf_multi_transmit *)tail_hif->body;
+		len = le16_to_cpu(tail_hif->len);
+		if (multi->num_tx_confs < U8_MAX && len + sizeof(*cnf) <= EMUL_BUF_SIZE) {
+			cnf = &multi->tx_conf_payload[multi->num_tx_confs++];
+			memset(cnf, 0, sizeof(*cnf));
+			tail_hif->len = cpu_to_le16(len + sizeof(*cnf));
+			goto fill;
+		}
+	}
+	multi = wfx_emul_push(bus, hif->interface, HIF_CNF_ID_MULTI_TRANSMIT,
+			      struct_size(multi, tx_conf_payload, 1));
+	if (!multi)
+		return;
+	multi->num_tx_confs = 1;
+	cnf = &multi->tx_conf_payload[0];
+
+fill:
+	if (!cnf)
+		return;
+	cnf->status = HIF_STATUS_SUCCESS;
+	cnf->packet_id = req->packet_id;
+}
+
+static void wfx_emul_rx_loopback(struct wfx_emul_priv *bus, const struct wfx_hif_msg *hif)
+{
+	const struct wfx_hif_req_tx *req = (const struct wfx_hif_req_tx *)hif->body;
+	size_t hdr_len = sizeof(*hif) + sizeof(*req) + req->fc_offset;
+	size_t frame_len = le16_to_cpu(hif->len) - hdr_len;
+	struct wfx_hif_ind_rx *ind;
+
+	if (le16_to_cpu(hif->len) < hdr_len)
+		return;
+	ind = wfx_emul_push(bus, hif->interface, HIF_IND_ID_RX, sizeof(*ind) + frame_len);
+	if (!ind)
+		return;
+	ind->status = HIF_STATUS_SUCCESS;
+	ind->channel_number = 1;
+	ind->rxed_rate = API_RATE_INDEX_G_54MBPS;
+	ind->rcpi_rssi = 100; /* -60dBm */
+	memcpy(ind->frame, (const u8 *)hif + hdr_len, frame_len);
+}
+
+static void wfx_emul_read_mib(struct wfx_emul_priv *bus, const struct wfx_hif_msg *hif)
+{
+	const struct wfx_hif_req_read_mib *req = (const struct wfx_hif_req_read_mib *)hif->body;
+	struct wfx_hif_cnf_read_mib *cnf;
+	size_t len = 0;
+
+	if (le16_to_cpu(req->mib_id) == HIF_MIB_ID_EXTENDED_COUNTERS_TABLE)
+		len = sizeof(struct wfx_hif_mib_extended_count_table);
+	if (le16_to_cpu(req->mib_id) == HIF_MIB_ID_COUNTERS_TABLE)
+		len = sizeof(struct wfx_hif_mib_count_table);
+	cnf = wfx_emul_push(bus, hif->interface, hif->id, sizeof(*cnf) + len);
+	if (!cnf)
+		return;
+	cnf->status = HIF_STATUS_SUCCESS;
+	cnf->mib_id = req->mib_id;
+	cnf->length = cpu_to_le16(len);
+}
+
+static void wfx_emul_write_mib(struct wfx_emul_priv *bus, const struct wfx_hif_msg *hif)
+{
+	const struct wfx_hif_req_write_mib *req = (const struct wfx_hif_req_write_mib *)hif->body;
+	const struct wfx_hif_mib_gl_set_multi_msg *multi_msg;
+	struct wfx_hif_cnf_write_mib *cnf;
+
+	if (le16_to_cpu(req->mib_id) == HIF_MIB_ID_GL_SET_MULTI_MSG) {
+		multi_msg = (const struct wfx_hif_mib_gl_set_multi_msg *)req->mib_data;
+		bus->multi_tx_conf = multi_msg->enable_multi_tx_conf;
+	}
+	cnf = wfx_emul_push(bus, hif->interface, hif->id, sizeof(*cnf));
+	if (cnf)
+		cnf->status = HIF_STATUS_SUCCESS;
+}
+
+static void wfx_emul_handle_req(struct wfx_emul_priv *bus, const struct wfx_hif_msg *hif)
+{
+	const struct wfx_hif_req_start_scan_alt *scan;
+	struct wfx_hif_ind_set_pm_mode_cmpl *pm_cmpl;
+	struct wfx_hif_ind_scan_cmpl *scan_cmpl;
+	__le32 *status;
+
+	switch (hif->id) {
+	case HIF_REQ_ID_TX:
+		wfx_emul_tx_confirm(bus, hif);
+		if (READ_ONCE(emul_rx_loopback))
+			wfx_emul_rx_loopback(bus, hif);
+		return;
+	case HIF_REQ_ID_READ_MIB:
+		wfx_emul_read_mib(bus, hif);
+		return;
+	case HIF_REQ_ID_WRITE_MIB:
+		wfx_emul_write_mib(bus, hif);
+		return;
+	case HIF_REQ_ID_SHUT_DOWN:
+		/* Chip does not reply to this request */
+		bus->bufs_used--;
+		return;
+	}
+
+	/* Other confirmations only contain a status */
+	status = wfx_emul_push(bus, hif->interface, hif->id, sizeof(*status));
+	if (status)
+		*status = HIF_STATUS_SUCCESS;
+
+	switch (hif->id) {
+	case HIF_REQ_ID_START_SCAN:
+		scan = (const struct wfx_hif_req_start_scan_alt *)hif->body;
+		scan_cmpl = wfx_emul_push(bus, hif->interface, HIF_IND_ID_SCAN_CMPL,
+					  sizeof(*scan_cmpl));
+		if (scan_cmpl)
+			scan_cmpl->num_channels_completed = scan->num_of_channels;
+		break;
+	case HIF_REQ_ID_SET_PM_MODE:
+		pm_cmpl = wfx_emul_push(bus, hif->interface, HIF_IND_ID_SET_PM_MODE_CMPL,
+					sizeof(*pm_cmpl));
+		if (pm_cmpl)
+			pm_cmpl->pm_mode = HIF_PM_MODE_ACTIVE;
+		break;
+	}
+}
+
+static int wfx_emul_queue_read(struct wfx_emul_priv *bus, void *dst, size_t count)
+{
+	struct wfx_emul_msg *msg = wfx_emul_out_head(bus);
+	struct wfx_hif_msg *hif;
+	size_t len;
+
+	if (!msg || count < 2) {
+		dev_warn(&bus->pdev->dev, "host reads an empty queue\n");
+		memset(dst, 0xFF, count);
+		return -EIO;
+	}
+	hif = (struct wfx_hif_msg *)msg->buf;
+	len = min(wfx_emul_msg_len(msg), count - 2);
+	memcpy(dst, msg->buf, len);
+	memset(dst + len, 0, count - len);
+	/* Confirmations release the input buffers */
+	if (!(hif->id & HIF_ID_IS_INDICATION)) {
+		if (hif->id == HIF_CNF_ID_MULTI_TRANSMIT)
+			bus->bufs_used -=
+				((struct wfx_hif_cnf_multi_transmit *)hif->body)->num_tx_confs;
+		else
+			bus->bufs_used--;
+	}
+	list_del(&msg->link);
+	bus->out_queue_len--;
+	kfree(msg);
+	*(__le16 *)(dst + count - 2) = cpu_to_le16(wfx_emul_ctrl_reg(bus) | CTRL_WLAN_READY);
+	return 0;
+}
+
+static int wfx_emul_queue_write(struct wfx_emul_priv *bus, const void *src, size_t count)
+{
+	const struct wfx_hif_msg *hif = src;
+
+	if (count < sizeof(*hif) || le16_to_cpu(hif->len) > count) {
+		dev_warn(&bus->pdev->dev, "host writes a corrupted message\n");
+		return -EIO;
+	}
+	if (bus->bufs_used >= emul_num_bufs) {
+		dev_warn_ratelimited(&bus->pdev->dev, "host overruns input buffers\n");
+		bus->reg_config |= CFG_ERR_BUF_OVERRUN;
+		return 0;
+	}
+	bus->bufs_used++;
+	wfx_emul_handle_req(bus, hif);
+	return 0;
+}
+
+static void wfx_emul_sram_read(struct wfx_emul_priv *bus, u32 addr, void *dst, size_t count)
+{
+	static const char label[] = "WF200 emulated bootloader";
+	u8 *buf = dst;
+
+	memset(dst, 0, count);
+	switch (addr) {
+	case WFX_DCA_GET:
+		/* Emulated firmware consumes data as soon as it is written */
+		if (count == sizeof(u32))
+			*(__le32 *)dst = cpu_to_le32(bus->dca_put);
+		break;
+	case WFX_DCA_NCP_STATUS:
+		if (count == sizeof(u32))
+			*(__le32 *)dst = cpu_to_le32(bus->ncp_status);
+		break;
+	case WFX_STATUS_INFO:
+		/* Report the bootloader has not detected any error */
+		if (count == sizeof(u32))
+			*(__le32 *)dst = cpu_to_le32(0x12345678);
+		break;
+	case WFX_BOOTLOADER_LABEL:
+		memcpy(dst, label, min(count, sizeof(label)));
+		break;
+	case WFX_PTE_INFO:
+		if (count >= PTE_INFO_SIZE)
+			buf[PTE_INFO_KEYSET_IDX] = emul_keyset;
+		break;
+	}
+}
+
+static void wfx_emul_sram_write(struct wfx_emul_priv *bus, u32 addr, const void *src, size_t count)
+{
+	u32 val;
+
+	/* Firmware image, signature and hash are ignored */
+	if (count != sizeof(u32))
+		return;
+	val = le32_to_cpup(src);
+	if (addr == WFX_DCA_PUT)
+		bus->dca_put = val;
+	if (addr != WFX_DCA_HOST_STATUS)
+		return;
+	switch (val) {
+	case HOST_READY:
+		bus->ncp_status = NCP_INFO_READY;
+		break;
+	case HOST_INFO_READ:
+		bus->ncp_status = NCP_READY;
+		break;
+	case HOST_UPLOAD_PENDING:
+		bus->ncp_status = NCP_DOWNLOAD_PENDING;
+		break;
+	case HOST_UPLOAD_COMPLETE:
+		bus->ncp_status = NCP_AUTH_OK;
+		break;
+	case HOST_OK_TO_JUMP:
+		wfx_emul_startup(bus);
+		break;
+	}
+}
+
+static int wfx_emul_copy_from_io(void *priv, unsigned int addr, void *dst, size_t count)
+{
+	struct wfx_emul_priv *bus = priv;
+	int ret = 0;
+
+	WARN(!IS_ALIGNED((uintptr_t)dst, 4), "unaligned buffer address");
+	wfx_emul_bus_delay();
+	mutex_lock(&bus->lock);
+	switch (addr) {
+	case WFX_REG_CONFIG:
+		memset(dst, 0, count);
+		*(__le32 *)dst = cpu_to_le32(bus->reg_config | EMUL_CFG_DEVICE_ID);
+		break;
+	case WFX_REG_CONTROL:
+		memset(dst, 0, count);
+		*(__le32 *)dst = cpu_to_le32(wfx_emul_ctrl_reg(bus));
+		break;
+	case WFX_REG_IN_OUT_QUEUE:
+		ret = wfx_emul_queue_read(bus, dst, count);
+		break;
+	case WFX_REG_SRAM_DPORT:
+		wfx_emul_sram_read(bus, bus->reg_base_addr, dst, count);
+		break;
+	default:
+		memset(dst, 0, count);
+		break;
+	}
+	mutex_unlock(&bus->lock);
+	return ret;
+}
+
+static int wfx_emul_copy_to_io(void *priv, unsigned int addr, const void *src, size_t count)
+{
+	struct wfx_emul_priv *bus = priv;
+	int ret = 0;
+
+	WARN(!IS_ALIGNED((uintptr_t)src, 4), "unaligned buffer address");
+	wfx_emul_bus_delay();
+	mutex_lock(&bus->lock);
+	switch (addr) {
+	case WFX_REG_CONFIG:
+		/* Prefetch is immediately done */
+		bus->reg_config = le32_to_cpup(src) & ~CFG_DEVICE_ID_MAJOR &
+				  ~(CFG_PREFETCH_AHB | CFG_PREFETCH_SRAM);
+		break;
+	case WFX_REG_CONTROL:
+		bus->reg_control = le32_to_cpup(src);
+		break;
+	case WFX_REG_BASE_ADDR:
+		bus->reg_base_addr = le32_to_cpup(src);
+		break;
+	case WFX_REG_IN_OUT_QUEUE:
+		ret = wfx_emul_queue_write(bus, src, count);
+		break;
+	case WFX_REG_SRAM_DPORT:
+		wfx_emul_sram_write(bus, bus->reg_base_addr, src, count);
+		break;
+	}
+	mutex_unlock(&bus->lock);
+	return ret;
+}
+
+static void wfx_emul_lock(void *priv)
+{
+}
+
+static void wfx_emul_unlock(void *priv)
+{
+}
+
+static void wfx_emul_irq_work(struct work_struct *work)
+{
+	struct wfx_emul_priv *bus = container_of(work, struct wfx_emul_priv, irq_work);
+
+	wfx_bh_irq_thread(bus->core);
+}
+
+static int wfx_emul_irq_subscribe(void *priv)
+{
+	struct wfx_emul_priv *bus = priv;
+
+	mutex_lock(&bus->lock);
+	bus->irq_enabled = true;
+	if (!list_empty(&bus->out_queue))
+		queue_work(system_highpri_wq, &bus->irq_work);
+	mutex_unlock(&bus->lock);
+	return 0;
+}
+
+static int wfx_emul_irq_unsubscribe(void *priv)
+{
+	struct wfx_emul_priv *bus = priv;
+
+	mutex_lock(&bus->lock);
+	bus->irq_enabled = false;
+	mutex_unlock(&bus->lock);
+	cancel_work_sync(&bus->irq_work);
+	return 0;
+}
+
+static size_t wfx_emul_align_size(void *priv, size_t size)
+{
+	return ALIGN(size, 4);
+}
+
+static const struct wfx_hwbus_ops wfx_emul_hwbus_ops = {
+	.copy_from_io    = wfx_emul_copy_from_io,
+	.copy_to_io      = wfx_emul_copy_to_io,
+	.irq_subscribe   = wfx_emul_irq_subscribe,
+	.irq_unsubscribe = wfx_emul_irq_unsubscribe,
+	.lock            = wfx_emul_lock,
+	.unlock          = wfx_emul_unlock,
+	.align_size      = wfx_emul_align_size,
+};
+
+static void wfx_emul_free_queue(void *data)
+{
+	struct wfx_emul_priv *bus = data;
+	struct wfx_emul_msg *msg, *tmp;
+
+	list_for_each_entry_safe(msg, tmp, &bus->out_queue, link)
+		kfree(msg);
+	mutex_destroy(&bus->lock);
+}
+
+static int wfx_emul_probe(struct platform_device *pdev)
+{
+	struct wfx_emul_priv *bus;
+	int i;
+
+	if (emul_num_bufs < 1 || emul_num_bufs > 255) {
+		dev_err(&pdev->dev, "invalid number of input buffers: %u\n", emul_num_bufs);
+		return -EINVAL;
+	}
+
+	bus = devm_kzalloc(&pdev->dev, sizeof(*bus), GFP_KERNEL);
+	if (!bus)
+		return -ENOMEM;
+	bus->pdev = pdev;
+	bus->ncp_status = NCP_NOT_READY;
+	mutex_init(&bus->lock);
+	INIT_LIST_HEAD(&bus->out_queue);
+	INIT_WORK(&bus->irq_work, wfx_emul_irq_work);
+	for (i = 0; i < ARRAY_SIZE(bus->mac_addr); i++)
+		eth_random_addr(bus->mac_addr[i]);
+	if (devm_add_action_or_reset(&pdev->dev, wfx_emul_free_queue, bus))
+		return -ENOMEM;
+	platform_set_drvdata(pdev, bus);
+
+	bus->core = wfx_init_common(&pdev->dev, &pdata_emul, &wfx_emul_hwbus_ops, bus);
+	if (!bus->core)
+		return -EIO;
+
+	return wfx_probe(bus->core);
+}
+
+static int wfx_emul_remove(struct platform_device *pdev)
+{
+	struct wfx_emul_priv *bus = platform_get_drvdata(pdev);
+
+	wfx_release(bus->core);
+	return 0;
+}
+
+static struct platform_driver wfx_emul_driver = {
+	.driver = {
+		.name = "wfx-emul",
+	},
+	.probe = wfx_emul_probe,
+	.remove = wfx_emul_remove,
+};
+
+int wfx_emul_register(void)
+{
+	struct platform_device *pdev;
+	int ret, i;
+
+	ret = platform_driver_register(&wfx_emul_driver);
+	if (ret)
+		return ret;
+	for (i = 0; i < min_t(unsigned int, emul_devices, EMUL_MAX_DEVICES); i++) {
+		pdev = platform_device_register_simple("wfx-emul", i, NULL, 0);
+		if (IS_ERR(pdev)) {
+			wfx_emul_unregister();
+			return PTR_ERR(pdev);
+		}
+		wfx_emul_devs[i] = pdev;
+	}
+	return 0;
+}
+
+void wfx_emul_unregister(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(wfx_emul_devs); i++) {
+		if (wfx_emul_devs[i])
+			platform_device_unregister(wfx_emul_devs[i]);
+		wfx_emul_devs[i] = NULL;
+	}
+	platform_driver_unregister(&wfx_emul_driver);
+}
@@ -116,7 +116,7 @@ static irqreturn_t wfx_sdio_irq_handler_ext(int irq, void *priv)
 	struct wfx_sdio_priv *bus = priv;
 
 	sdio_claim_host(bus->func);
-	wfx_bh_request_rx(bus->core);
+	wfx_bh_irq_thread(bus->core);
 	sdio_release_host(bus->func);
 	return IRQ_HANDLED;
 }
@@ -172,6 +172,20 @@ static size_t wfx_sdio_align_size(void *priv, size_t size)
 	return sdio_align_size(bus->func, size);
 }
 
+static int wfx_sdio_set_block_size(void *priv, unsigned int size)
+{
+	struct wfx_sdio_priv *bus = priv;
+
+	return sdio_set_block_size(bus->func, size);
+}
+
+static unsigned int wfx_sdio_get_block_size(void *priv)
+{
+	struct wfx_sdio_priv *bus = priv;
+
+	return bus->func->cur_blksize;
+}
+
 static const struct wfx_hwbus_ops wfx_sdio_hwbus_ops = {
 	.copy_from_io    = wfx_sdio_copy_from_io,
 	.copy_to_io      = wfx_sdio_copy_to_io,
@@ -180,6 +194,8 @@ static const struct wfx_hwbus_ops wfx_sdio_hwbus_ops = {
 	.lock            = wfx_sdio_lock,
 	.unlock          = wfx_sdio_unlock,
 	.align_size      = wfx_sdio_align_size,
+	.set_block_size  = wfx_sdio_set_block_size,
+	.get_block_size  = wfx_sdio_get_block_size,
 };
 
 static const struct of_device_id wfx_sdio_of_match[] = {
@@ -219,7 +235,9 @@ static int wfx_sdio_probe(struct sdio_func *func, const struct sdio_device_id *i
 
 	sdio_claim_host(func);
 	ret = sdio_enable_func(func);
-	/* Block of 64 bytes is more efficient than 512B for frame sizes < 4k */
+	/* Block of 64 bytes is more efficient than 512B for frame sizes < 4k. However, the best
+	 * value depends on the host (see the calibrate_bus parameter).
+	 */
 	sdio_set_block_size(func, 64);
 	sdio_release_host(func);
 	if (ret)
@@ -47,11 +47,27 @@ static const struct wfx_platform_data pdata_brd8023a = {
 	.use_rising_clk = true,
 };
 
+/* Number of HIF messages that can be sent without waiting for the end of the previous ones */
+#define WFX_SPI_ASYNC_SLOTS 2
+
+struct wfx_spi_async_slot {
+	/* regaddr is sent with a DMA, so it must not share its cache line */
+	u16 regaddr ____cacheline_aligned;
+	struct spi_message msg ____cacheline_aligned;
+	struct spi_transfer t_addr;
+	struct spi_transfer t_msg;
+	struct completion done;
+	struct wfx_spi_priv *bus;
+};
+
 struct wfx_spi_priv {
 	struct spi_device *func;
 	struct wfx_dev *core;
 	struct gpio_desc *gpio_reset;
 	bool need_swab;
+	struct wfx_spi_async_slot async[WFX_SPI_ASYNC_SLOTS];
+	int async_next;
+	atomic_t async_errors;
 };
 
 /* The chip reads 16bits of data at time and place them directly into (little endian) CPU register.
@@ -94,6 +110,52 @@ static int wfx_spi_copy_from_io(void *priv, unsigned int addr, void *dst, size_t
 	return ret;
 }
 
+static void wfx_spi_async_complete(void *context)
+{
+	struct wfx_spi_async_slot *slot = context;
+
+	if (slot->msg.status) {
+		atomic_inc(&slot->bus->async_errors);
+		dev_err(&slot->bus->func->dev, "asynchronous transfer failed: %d\n",
+			slot->msg.status);
+	}
+	complete(&slot->done);
+}
+
+/* The HIF messages are sent with spi_async(). So, the bh can prepare the next message while the
+ * controller is sending the current one. Since the SPI core processes the messages of a device in
+ * order, the next accesses (e.g. the read of the confirmation) still happen after the end of the
+ * write. However, the buffer must stay valid until wfx_spi_flush() is called.
+ */
+static int wfx_spi_write_async(struct wfx_spi_priv *bus, unsigned int addr,
+			       const void *src, size_t count)
+{
+	struct wfx_spi_async_slot *slot = &bus->async[bus->async_next];
+	int ret;
+
+	/* Wait for the message sent WFX_SPI_ASYNC_SLOTS messages ago */
+	wait_for_completion(&slot->done);
+	reinit_completion(&slot->done);
+	slot->regaddr = (addr << 12) | (count / 2);
+	cpu_to_le16s(&slot->regaddr);
+	if (bus->need_swab)
+		swab16s(&slot->regaddr);
+	slot->t_msg.tx_buf = src;
+	slot->t_msg.len = count;
+	spi_message_init(&slot->msg);
+	spi_message_add_tail(&slot->t_addr, &slot->msg);
+	spi_message_add_tail(&slot->t_msg, &slot->msg);
+	slot->msg.complete = wfx_spi_async_complete;
+	slot->msg.context = slot;
+	ret = spi_async(bus->func, &slot->msg);
+	if (ret) {
+		complete(&slot->done);
+		return ret;
+	}
+	bus->async_next = (bus->async_next + 1) % WFX_SPI_ASYNC_SLOTS;
+	return 0;
+}
+
 static int wfx_spi_copy_to_io(void *priv, unsigned int addr, const void *src, size_t count)
 {
 	struct wfx_spi_priv *bus = priv;
@@ -114,6 +176,9 @@ static int wfx_spi_copy_to_io(void *priv, unsigned int addr, const void *src, si
 	WARN(count % 2, "buffer size must be a multiple of 2");
 	WARN(regaddr & SET_READ, "bad addr or size overflow");
 
+	if (addr == WFX_REG_IN_OUT_QUEUE)
+		return wfx_spi_write_async(bus, addr, src, count);
+
 	cpu_to_le16s(&regaddr);
 
 	/* Register address and CONFIG content always use 16bit big endian
@@ -136,6 +201,33 @@ static int wfx_spi_copy_to_io(void *priv, unsigned int addr, const void *src, si
 	return ret;
 }
 
+static int wfx_spi_flush(void *priv)
+{
+	struct wfx_spi_priv *bus = priv;
+	int i;
+
+	for (i = 0; i < WFX_SPI_ASYNC_SLOTS; i++) {
+		wait_for_completion(&bus->async[i].done);
+		complete(&bus->async[i].done);
+	}
+	return atomic_xchg(&bus->async_errors, 0) ? -EIO : 0;
+}
+
+static void wfx_spi_async_init(struct wfx_spi_priv *bus)
+{
+	struct wfx_spi_async_slot *slot;
+	int i;
+
+	for (i = 0; i < WFX_SPI_ASYNC_SLOTS; i++) {
+		slot = &bus->async[i];
+		slot->bus = bus;
+		slot->t_addr.tx_buf = &slot->regaddr;
+		slot->t_addr.len = sizeof(slot->regaddr);
+		init_completion(&slot->done);
+		complete(&slot->done);
+	}
+}
+
 static void wfx_spi_lock(void *priv)
 {
 }
@@ -148,7 +240,7 @@ static irqreturn_t wfx_spi_irq_handler(int irq, void *priv)
 {
 	struct wfx_spi_priv *bus = priv;
 
-	wfx_bh_request_rx(bus->core);
+	wfx_bh_irq_thread(bus->core);
 	return IRQ_HANDLED;
 }
 
@@ -187,6 +279,7 @@ static const struct wfx_hwbus_ops wfx_spi_hwbus_ops = {
 	.lock            = wfx_spi_lock,
 	.unlock          = wfx_spi_unlock,
 	.align_size      = wfx_spi_align_size,
+	.flush           = wfx_spi_flush,
 };
 
 static int wfx_spi_probe(struct spi_device *func)
@@ -218,6 +311,7 @@ static int wfx_spi_probe(struct spi_device *func)
 	if (!bus)
 		return -ENOMEM;
 	bus->func = func;
+	wfx_spi_async_init(bus);
 	if (func->bits_per_word == 8 || IS_ENABLED(CONFIG_CPU_BIG_ENDIAN))
 		bus->need_swab = true;
 	spi_set_drvdata(func, bus);
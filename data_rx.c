@@ -6,6 +6,7 @@
  * Copyright (c) 2010, ST-Ericsson
  */
 #include <linux/etherdevice.h>
+#include <linux/netdevice.h>
 #include <net/mac80211.h>
 
 #include "data_rx.h"
@@ -13,6 +14,9 @@
 #include "bh.h"
 #include "sta.h"
 
+/* Beyond this limit, the bh drops the frames instead of waiting for the NAPI poll */
+#define WFX_RX_NAPI_QUEUE_MAX 1024
+
 static void wfx_rx_handle_ba(struct wfx_vif *wvif, struct ieee80211_mgmt *mgmt)
 {
 	struct ieee80211_vif *vif = wvif_to_vif(wvif);
@@ -85,9 +89,80 @@ void wfx_rx_cb(struct wfx_vif *wvif, const struct wfx_hif_ind_rx *arg, struct sk
 		goto drop;
 	}
 
-	ieee80211_rx_irqsafe(wvif->wdev->hw, skb);
+	if (skb_queue_len(&wvif->wdev->rx_napi_queue) >= WFX_RX_NAPI_QUEUE_MAX) {
+		wvif->wdev->rx_napi_drops++;
+		goto drop;
+	}
+	/* Delivered by wfx_rx_napi_poll() once the bh calls wfx_rx_napi_schedule() */
+	skb_queue_tail(&wvif->wdev->rx_napi_queue, skb);
 	return;
 
 drop:
 	dev_kfree_skb(skb);
 }
+
+static int wfx_rx_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct wfx_dev *wdev = container_of(napi, struct wfx_dev, rx_napi);
+	ktime_t start = ktime_get();
+	struct sk_buff *skb;
+	int done = 0;
+
+	while (done < budget) {
+		skb = skb_dequeue(&wdev->rx_napi_queue);
+		if (!skb)
+			break;
+		wdev->rx_napi_bytes += skb->len;
+		ieee80211_rx_napi(wdev->hw, NULL, skb, napi);
+		done++;
+	}
+	wdev->rx_napi_polls++;
+	wdev->rx_napi_frames += done;
+	wdev->rx_napi_time_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (done == budget) {
+		wdev->rx_napi_budget_exhausted++;
+		return budget;
+	}
+	/* The bh may have queued a frame after the queue was found empty */
+	if (napi_complete_done(napi, done) && !skb_queue_empty(&wdev->rx_napi_queue))
+		napi_schedule(napi);
+	return done;
+}
+
+void wfx_rx_napi_schedule(struct wfx_dev *wdev)
+{
+	if (skb_queue_empty(&wdev->rx_napi_queue))
+		return;
+	/* The bh runs in process context. local_bh_enable() runs the pending softirq. */
+	local_bh_disable();
+	napi_schedule(&wdev->rx_napi);
+	local_bh_enable();
+}
+
+/* The NAPI context is only enabled while mac80211 has started the device (see wfx_start()) */
+void wfx_rx_napi_init(struct wfx_dev *wdev)
+{
+	skb_queue_head_init(&wdev->rx_napi_queue);
+	init_dummy_netdev(&wdev->napi_dev);
+	netif_napi_add(&wdev->napi_dev, &wdev->rx_napi, wfx_rx_napi_poll);
+}
+
+void wfx_rx_napi_deinit(struct wfx_dev *wdev)
+{
+	netif_napi_del(&wdev->rx_napi);
+	skb_queue_purge(&wdev->rx_napi_queue);
+}
+
+void wfx_rx_napi_start(struct wfx_dev *wdev)
+{
+	/* Frames received while the device was stopped */
+	skb_queue_purge(&wdev->rx_napi_queue);
+	napi_enable(&wdev->rx_napi);
+}
+
+/* mac80211 does not accept frames once the device is stopped, so the queued ones are dropped */
+void wfx_rx_napi_stop(struct wfx_dev *wdev)
+{
+	napi_disable(&wdev->rx_napi);
+	skb_queue_purge(&wdev->rx_napi_queue);
+}
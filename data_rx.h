@@ -8,10 +8,16 @@
 #ifndef WFX_DATA_RX_H
 #define WFX_DATA_RX_H
 
+struct wfx_dev;
 struct wfx_vif;
 struct sk_buff;
 struct wfx_hif_ind_rx;
 
 void wfx_rx_cb(struct wfx_vif *wvif, const struct wfx_hif_ind_rx *arg, struct sk_buff *skb);
+void wfx_rx_napi_schedule(struct wfx_dev *wdev);
+void wfx_rx_napi_init(struct wfx_dev *wdev);
+void wfx_rx_napi_deinit(struct wfx_dev *wdev);
+void wfx_rx_napi_start(struct wfx_dev *wdev);
+void wfx_rx_napi_stop(struct wfx_dev *wdev);
 
 #endif
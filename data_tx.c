@@ -98,12 +98,27 @@ static int wfx_tx_policy_release(struct wfx_tx_policy_cache *cache, struct wfx_t
 	return ret;
 }
 
+/* Recycle the oldest entry of the "free" list. Entries in the "used" list are never modified, so
+ * the frames already queued keep a valid policy while the new one is uploaded.
+ */
+static int wfx_tx_policy_alloc(struct wfx_tx_policy_cache *cache, struct wfx_tx_policy *wanted)
+{
+	struct wfx_tx_policy *entry = list_last_entry(&cache->free, struct wfx_tx_policy, link);
+
+	if (memzcmp(entry->rates, sizeof(entry->rates)))
+		cache->evictions++;
+	memcpy(entry->rates, wanted->rates, sizeof(entry->rates));
+	entry->uploaded = false;
+	entry->usage_count = 0;
+	entry->generation++;
+	return entry - cache->cache;
+}
+
 static int wfx_tx_policy_get(struct wfx_vif *wvif, struct ieee80211_tx_rate *rates, bool *renew)
 {
 	int idx;
 	struct wfx_tx_policy_cache *cache = &wvif->tx_policy_cache;
 	struct wfx_tx_policy wanted;
-	struct wfx_tx_policy *entry;
 
 	wfx_tx_policy_build(wvif, &wanted, rates);
 
@@ -114,17 +129,14 @@ static int wfx_tx_policy_get(struct wfx_vif *wvif, struct ieee80211_tx_rate *rat
 		return HIF_TX_RETRY_POLICY_INVALID;
 	}
 	idx = wfx_tx_policy_find(cache, &wanted);
-	if (idx >= 0) {
-		*renew = false;
-	} else {
-		/* If policy is not found create a new one using the oldest entry in "free" list */
-		*renew = true;
-		entry = list_entry(cache->free.prev, struct wfx_tx_policy, link);
-		memcpy(entry->rates, wanted.rates, sizeof(entry->rates));
-		entry->uploaded = false;
-		entry->usage_count = 0;
-		idx = entry - cache->cache;
-	}
+	if (idx < 0)
+		idx = wfx_tx_policy_alloc(cache, &wanted);
+	/* Only the frames using a policy not yet uploaded have to wait */
+	*renew = !cache->cache[idx].uploaded;
+	if (*renew)
+		cache->misses++;
+	else
+		cache->hits++;
 	wfx_tx_policy_use(cache, &cache->cache[idx]);
 	if (list_empty(&cache->free))
 		ieee80211_stop_queues(wvif->wdev->hw);
@@ -143,32 +155,41 @@ static void wfx_tx_policy_put(struct wfx_vif *wvif, int idx)
 	locked = list_empty(&cache->free);
 	usage = wfx_tx_policy_release(cache, &cache->cache[idx]);
 	if (locked && !usage)
-		ieee80211_wake_queues(wvif->wdev->hw);
+		wfx_tx_queues_wake(wvif->wdev);
 	spin_unlock_bh(&cache->lock);
 }
 
 static int wfx_tx_policy_upload(struct wfx_vif *wvif)
 {
-	struct wfx_tx_policy *policies = wvif->tx_policy_cache.cache;
+	struct wfx_tx_policy_cache *cache = &wvif->tx_policy_cache;
+	struct wfx_tx_policy *policies = cache->cache;
+	unsigned int generation;
 	u8 tmp_rates[12];
 	int i, is_used;
 
 	do {
-		spin_lock_bh(&wvif->tx_policy_cache.lock);
-		for (i = 0; i < ARRAY_SIZE(wvif->tx_policy_cache.cache); ++i) {
+		spin_lock_bh(&cache->lock);
+		for (i = 0; i < ARRAY_SIZE(cache->cache); ++i) {
 			is_used = memzcmp(policies[i].rates, sizeof(policies[i].rates));
 			if (!policies[i].uploaded && is_used)
 				break;
 		}
-		if (i < ARRAY_SIZE(wvif->tx_policy_cache.cache)) {
-			policies[i].uploaded = true;
+		if (i < ARRAY_SIZE(cache->cache)) {
+			generation = policies[i].generation;
 			memcpy(tmp_rates, policies[i].rates, sizeof(tmp_rates));
-			spin_unlock_bh(&wvif->tx_policy_cache.lock);
+			spin_unlock_bh(&cache->lock);
 			wfx_hif_set_tx_rate_retry_policy(wvif, i, tmp_rates);
+			/* If the entry has been recycled meanwhile, it will be uploaded again */
+			spin_lock_bh(&cache->lock);
+			if (policies[i].generation == generation)
+				policies[i].uploaded = true;
+			spin_unlock_bh(&cache->lock);
+			/* Frames waiting for this policy can now be sent */
+			wfx_bh_request_tx(wvif->wdev);
 		} else {
-			spin_unlock_bh(&wvif->tx_policy_cache.lock);
+			spin_unlock_bh(&cache->lock);
 		}
-	} while (i < ARRAY_SIZE(wvif->tx_policy_cache.cache));
+	} while (i < ARRAY_SIZE(cache->cache));
 	return 0;
 }
 
@@ -177,15 +198,27 @@ void wfx_tx_policy_upload_work(struct work_struct *work)
 	struct wfx_vif *wvif = container_of(work, struct wfx_vif, tx_policy_upload_work);
 
 	wfx_tx_policy_upload(wvif);
-	wfx_tx_unlock(wvif->wdev);
 }
 
+/* Called from the bh. Frames are kept in their queue until their retry policy is uploaded. */
+bool wfx_tx_policy_is_ready(struct wfx_dev *wdev, struct sk_buff *skb)
+{
+	struct wfx_hif_msg *hif = (struct wfx_hif_msg *)skb->data;
+	struct wfx_hif_req_tx *req = (struct wfx_hif_req_tx *)hif->body;
+	struct wfx_vif *wvif = wdev_to_wvif(wdev, hif->interface);
+
+	if (!wvif || req->retry_policy_index == HIF_TX_RETRY_POLICY_INVALID)
+		return true;
+	return READ_ONCE(wvif->tx_policy_cache.cache[req->retry_policy_index].uploaded);
+}
+
+/* The statistics are kept across the resets of the cache */
 void wfx_tx_policy_init(struct wfx_vif *wvif)
 {
 	struct wfx_tx_policy_cache *cache = &wvif->tx_policy_cache;
 	int i;
 
-	memset(cache, 0, sizeof(*cache));
+	memset(cache->cache, 0, sizeof(cache->cache));
 
 	spin_lock_init(&cache->lock);
 	INIT_LIST_HEAD(&cache->used);
@@ -284,14 +317,95 @@ static u8 wfx_tx_get_retry_policy_id(struct wfx_vif *wvif, struct ieee80211_tx_i
 	if (ret == HIF_TX_RETRY_POLICY_INVALID)
 		dev_warn(wvif->wdev->dev, "unable to get a valid Tx policy");
 
-	if (tx_policy_renew) {
-		wfx_tx_lock(wvif->wdev);
-		if (!schedule_work(&wvif->tx_policy_upload_work))
-			wfx_tx_unlock(wvif->wdev);
-	}
+	if (tx_policy_renew)
+		schedule_work(&wvif->tx_policy_upload_work);
 	return ret;
 }
 
+/* Add the policy that mac80211 uses for a frame sent at a single rate (see
+ * rate_control_send_low()) to the cache, without using it.
+ */
+static void wfx_tx_policy_seed(struct wfx_vif *wvif, int rate_idx, u8 count)
+{
+	struct wfx_tx_policy_cache *cache = &wvif->tx_policy_cache;
+	struct ieee80211_tx_rate rates[IEEE80211_TX_MAX_RATES] = { };
+	struct wfx_tx_policy wanted;
+	int i, idx;
+
+	for (i = 0; i < ARRAY_SIZE(rates); i++)
+		rates[i].idx = -1;
+	rates[0].idx = rate_idx;
+	rates[0].count = count;
+	wfx_tx_fixup_rates(rates);
+	wfx_tx_policy_build(wvif, &wanted, rates);
+
+	spin_lock_bh(&cache->lock);
+	if (wfx_tx_policy_find(cache, &wanted) < 0 && !list_empty(&cache->free)) {
+		idx = wfx_tx_policy_alloc(cache, &wanted);
+		/* Move it to the head of the "free" list, so it is recycled last */
+		list_move(&cache->cache[idx].link, &cache->free);
+	}
+	spin_unlock_bh(&cache->lock);
+}
+
+/* Upload ahead of time the policies used by management, multicast and EAPOL frames. Without sta,
+ * mac80211 uses the lowest basic rate. Else, it uses the lowest rate supported by the station.
+ */
+void wfx_tx_policy_preload(struct wfx_vif *wvif, struct ieee80211_sta *sta)
+{
+	struct ieee80211_vif *vif = wvif_to_vif(wvif);
+	struct ieee80211_hw *hw = wvif->wdev->hw;
+	u32 rates;
+
+	if (wvif->wdev->fw_rate_control)
+		return;
+	if (sta)
+		rates = sta->deflink.supp_rates[NL80211_BAND_2GHZ];
+	else
+		rates = vif->bss_conf.basic_rates;
+	if (!rates)
+		return;
+	wfx_tx_policy_seed(wvif, ffs(rates) - 1, hw->max_rate_tries);
+	if (!sta)
+		wfx_tx_policy_seed(wvif, ffs(rates) - 1, 1);
+	schedule_work(&wvif->tx_policy_upload_work);
+}
+
+/* In firmware rate control mode, the firmware choose the rates up to the fastest rate supported by
+ * the peer. Frames without peer are sent at the lowest basic rate.
+ */
+static u8 wfx_tx_get_max_rate(struct wfx_vif *wvif, struct ieee80211_sta *sta)
+{
+	struct ieee80211_supported_band *band = wvif->wdev->hw->wiphy->bands[NL80211_BAND_2GHZ];
+	struct ieee80211_vif *vif = wvif_to_vif(wvif);
+	u32 rates;
+
+	if (sta && sta->deflink.ht_cap.ht_supported && sta->deflink.ht_cap.mcs.rx_mask[0])
+		return fls(sta->deflink.ht_cap.mcs.rx_mask[0]) - 1 + 14;
+	if (sta && sta->deflink.supp_rates[NL80211_BAND_2GHZ]) {
+		rates = sta->deflink.supp_rates[NL80211_BAND_2GHZ];
+		return band->bitrates[fls(rates) - 1].hw_value;
+	}
+	rates = vif->bss_conf.basic_rates;
+	if (rates)
+		return band->bitrates[ffs(rates) - 1].hw_value;
+	return band->bitrates[0].hw_value;
+}
+
+static void wfx_tx_fill_fw_rate_control(struct wfx_vif *wvif, struct ieee80211_sta *sta,
+					struct wfx_hif_req_tx *req)
+{
+	req->max_tx_rate = wfx_tx_get_max_rate(wvif, sta);
+	req->retry_policy_index = HIF_TX_RETRY_POLICY_INVALID;
+	if (req->max_tx_rate >= 14) {
+		req->frame_format = HIF_FRAME_FORMAT_MIXED_FORMAT_HT;
+		if (sta->deflink.ht_cap.cap & IEEE80211_HT_CAP_SGI_20)
+			req->short_gi = 1;
+	} else {
+		req->frame_format = HIF_FRAME_FORMAT_NON_HT;
+	}
+}
+
 static int wfx_tx_get_frame_format(struct ieee80211_tx_info *tx_info)
 {
 	if (!(tx_info->driver_rates[0].flags & IEEE80211_TX_RC_MCS))
@@ -314,6 +428,28 @@ static int wfx_tx_get_icv_len(struct ieee80211_key_conf *hw_key)
 	return hw_key->icv_len + mic_space;
 }
 
+/* The HIF message is built in place, in front of the 802.11 frame, and sent in one transfer.
+ * mac80211 reserves extra_tx_headroom and never passes non-linear skbs to this driver. So, the
+ * copies below should not happen. They are counted to detect it.
+ */
+static int wfx_tx_make_room(struct wfx_dev *wdev, struct sk_buff *skb, int icv_size)
+{
+	int head_need = sizeof(struct wfx_hif_msg) + sizeof(struct wfx_hif_req_tx) + 3;
+	int tail_need = icv_size;
+
+	if (skb_is_nonlinear(skb)) {
+		wdev->tx_copy_nonlinear++;
+		if (skb_linearize(skb))
+			return -ENOMEM;
+	}
+	head_need = max(head_need - (int)skb_headroom(skb), 0);
+	tail_need = max(tail_need - (int)skb_tailroom(skb), 0);
+	if (!head_need && !tail_need)
+		return 0;
+	wdev->tx_copy_room++;
+	return pskb_expand_head(skb, ALIGN(head_need, 4), tail_need, GFP_ATOMIC);
+}
+
 static int wfx_tx_inner(struct wfx_vif *wvif, struct ieee80211_sta *sta, struct sk_buff *skb)
 {
 	struct wfx_hif_msg *hif_msg;
@@ -321,19 +457,31 @@ static int wfx_tx_inner(struct wfx_vif *wvif, struct ieee80211_sta *sta, struct
 	struct wfx_tx_priv *tx_priv;
 	struct ieee80211_tx_info *tx_info = IEEE80211_SKB_CB(skb);
 	struct ieee80211_key_conf *hw_key = tx_info->control.hw_key;
-	struct ieee80211_hdr *hdr = (struct ieee80211_hdr *)skb->data;
+	struct ieee80211_hdr *hdr;
 	int queue_id = skb_get_queue_mapping(skb);
-	size_t offset = (size_t)skb->data & 3;
-	int wmsg_len = sizeof(struct wfx_hif_msg) + sizeof(struct wfx_hif_req_tx) + offset;
+	size_t offset;
+	int wmsg_len;
+	u32 lifetime;
+
+	if (wfx_tx_make_room(wvif->wdev, skb, wfx_tx_get_icv_len(hw_key)))
+		return -ENOMEM;
+	hdr = (struct ieee80211_hdr *)skb->data;
+	offset = (size_t)skb->data & 3;
+	wmsg_len = sizeof(struct wfx_hif_msg) + sizeof(struct wfx_hif_req_tx) + offset;
 
 	WARN(queue_id >= IEEE80211_NUM_ACS, "unsupported queue_id");
-	wfx_tx_fixup_rates(tx_info->driver_rates);
+	if (!wvif->wdev->fw_rate_control)
+		wfx_tx_fixup_rates(tx_info->driver_rates);
 
 	/* From now tx_info->control is unusable */
 	memset(tx_info->rate_driver_data, 0, sizeof(struct wfx_tx_priv));
 	/* Fill tx_priv */
 	tx_priv = (struct wfx_tx_priv *)tx_info->rate_driver_data;
 	tx_priv->icv_size = wfx_tx_get_icv_len(hw_key);
+	lifetime = READ_ONCE(wvif->wdev->tx_lifetime[queue_id]);
+	/* Multicast frames buffered for the next DTIM often wait longer than the lifetime */
+	if (lifetime && !(tx_info->flags & IEEE80211_TX_CTL_SEND_AFTER_DTIM))
+		tx_priv->deadline = ktime_add_ms(ktime_get(), lifetime);
 
 	/* Fill hif_msg */
 	WARN(skb_headroom(skb) < wmsg_len, "not enough space in skb");
@@ -366,10 +514,14 @@ static int wfx_tx_inner(struct wfx_vif *wvif, struct ieee80211_sta *sta, struct
 	/* Queue index are inverted between firmware and Linux */
 	req->queue_id = 3 - queue_id;
 	req->peer_sta_id = wfx_tx_get_link_id(wvif, sta, hdr);
-	req->retry_policy_index = wfx_tx_get_retry_policy_id(wvif, tx_info);
-	req->frame_format = wfx_tx_get_frame_format(tx_info);
-	if (tx_info->driver_rates[0].flags & IEEE80211_TX_RC_SHORT_GI)
-		req->short_gi = 1;
+	if (wvif->wdev->fw_rate_control) {
+		wfx_tx_fill_fw_rate_control(wvif, sta, req);
+	} else {
+		req->retry_policy_index = wfx_tx_get_retry_policy_id(wvif, tx_info);
+		req->frame_format = wfx_tx_get_frame_format(tx_info);
+		if (tx_info->driver_rates[0].flags & IEEE80211_TX_RC_SHORT_GI)
+			req->short_gi = 1;
+	}
 	if (tx_info->flags & IEEE80211_TX_CTL_SEND_AFTER_DTIM)
 		req->after_dtim = 1;
 
@@ -377,7 +529,6 @@ static int wfx_tx_inner(struct wfx_vif *wvif, struct ieee80211_sta *sta, struct
 	wfx_tx_queues_put(wvif, skb);
 	if (tx_info->flags & IEEE80211_TX_CTL_SEND_AFTER_DTIM)
 		schedule_work(&wvif->update_tim_work);
-	wfx_bh_request_tx(wvif->wdev);
 	return 0;
 }
 
@@ -409,6 +560,7 @@ void wfx_tx(struct ieee80211_hw *hw, struct ieee80211_tx_control *control, struc
 	}
 	if (wfx_tx_inner(wvif, sta, skb))
 		goto drop;
+	wfx_bh_request_tx(wdev);
 
 	return;
 
@@ -416,6 +568,52 @@ drop:
 	ieee80211_tx_status_irqsafe(wdev->hw, skb);
 }
 
+void wfx_wake_tx_queue(struct ieee80211_hw *hw, struct ieee80211_txq *txq)
+{
+	struct wfx_dev *wdev = hw->priv;
+
+	wfx_bh_request_tx(wdev);
+}
+
+/* Called from the bh. Move frames from the mac80211 TXQs to the queues of the driver. mac80211
+ * elects the stations according to their airtime usage. Only a few frames per queue are retrieved,
+ * so most of the queuing is done (and managed by FQ-CoDel) in mac80211.
+ */
+void wfx_tx_pull_txqs(struct wfx_dev *wdev)
+{
+	struct ieee80211_hw *hw = wdev->hw;
+	struct ieee80211_txq *txq;
+	struct wfx_queue *queue;
+	struct wfx_vif *wvif;
+	struct sk_buff *skb;
+	int ac;
+
+	if (atomic_read(&wdev->tx_lock))
+		return;
+	for (ac = 0; ac < IEEE80211_NUM_ACS; ac++) {
+		/* The bh runs in process context, but mac80211 expects BHs disabled */
+		local_bh_disable();
+		rcu_read_lock();
+		ieee80211_txq_schedule_start(hw, ac);
+		while ((txq = ieee80211_next_txq(hw, ac)) != NULL) {
+			wvif = (struct wfx_vif *)txq->vif->drv_priv;
+			queue = &wvif->tx_queue[ac];
+			while (skb_queue_len(&queue->normal) < queue->high_watermark) {
+				skb = ieee80211_tx_dequeue(hw, txq);
+				if (!skb)
+					break;
+				if (wfx_is_action_back((struct ieee80211_hdr *)skb->data) ||
+				    wfx_tx_inner(wvif, txq->sta, skb))
+					ieee80211_tx_status_irqsafe(hw, skb);
+			}
+			ieee80211_return_txq(hw, txq, false);
+		}
+		ieee80211_txq_schedule_end(hw, ac);
+		rcu_read_unlock();
+		local_bh_enable();
+	}
+}
+
 static void wfx_skb_dtor(struct wfx_vif *wvif, struct sk_buff *skb)
 {
 	struct wfx_hif_msg *hif = (struct wfx_hif_msg *)skb->data;
@@ -432,6 +630,31 @@ static void wfx_skb_dtor(struct wfx_vif *wvif, struct sk_buff *skb)
 	ieee80211_tx_status_irqsafe(wvif->wdev->hw, skb);
 }
 
+/* In firmware rate control mode, only report the rate of the last attempt */
+static void wfx_tx_fill_fw_rates(struct wfx_dev *wdev, struct ieee80211_tx_info *tx_info,
+				 const struct wfx_hif_cnf_tx *arg)
+{
+	struct ieee80211_supported_band *band = wdev->hw->wiphy->bands[NL80211_BAND_2GHZ];
+	struct ieee80211_tx_rate *rates = tx_info->status.rates;
+	int i;
+
+	memset(rates, 0, sizeof(tx_info->status.rates));
+	for (i = 1; i < IEEE80211_TX_MAX_RATES; i++)
+		rates[i].idx = -1;
+	rates[0].count = arg->ack_failures;
+	if (!arg->status || arg->ack_failures)
+		rates[0].count += 1;
+	if (arg->txed_rate >= 14) {
+		rates[0].idx = arg->txed_rate - 14;
+		rates[0].flags = IEEE80211_TX_RC_MCS;
+		return;
+	}
+	rates[0].idx = -1;
+	for (i = 0; i < band->n_bitrates; i++)
+		if (band->bitrates[i].hw_value == arg->txed_rate)
+			rates[0].idx = i;
+}
+
 static void wfx_tx_fill_rates(struct wfx_dev *wdev, struct ieee80211_tx_info *tx_info,
 			      const struct wfx_hif_cnf_tx *arg)
 {
@@ -472,6 +695,7 @@ void wfx_tx_confirm_cb(struct wfx_dev *wdev, const struct wfx_hif_cnf_tx *arg)
 {
 	const struct wfx_tx_priv *tx_priv;
 	struct ieee80211_tx_info *tx_info;
+	struct wfx_queue *queue;
 	struct wfx_vif *wvif;
 	struct sk_buff *skb;
 
@@ -488,9 +712,22 @@ void wfx_tx_confirm_cb(struct wfx_dev *wdev, const struct wfx_hif_cnf_tx *arg)
 	if (!wvif)
 		return;
 
+	queue = &wvif->tx_queue[skb_get_queue_mapping(skb)];
+	wfx_tx_queue_update_limit(queue, le32_to_cpu(arg->tx_queue_delay));
+	if (arg->status == HIF_STATUS_TX_FAIL_TIMEOUT)
+		atomic_inc(&queue->expired_fw);
+	if (arg->aggr)
+		atomic_inc(&queue->cnf_aggr);
+	if (arg->txop_limit)
+		atomic_inc(&queue->cnf_txop_limit);
+
 	/* Note that wfx_pending_get_pkt_us_delay() get data from tx_info */
-	_trace_tx_stats(arg, skb, wfx_pending_get_pkt_us_delay(wdev, skb));
-	wfx_tx_fill_rates(wdev, tx_info, arg);
+	_trace_tx_stats(arg, skb, wfx_pending_get_pkt_us_delay(wdev, skb),
+			tx_priv->pending_lookups);
+	if (wdev->fw_rate_control)
+		wfx_tx_fill_fw_rates(wdev, tx_info, arg);
+	else
+		wfx_tx_fill_rates(wdev, tx_info, arg);
 	skb_trim(skb, skb->len - tx_priv->icv_size);
 
 	/* From now, you can touch to tx_info->status, but do not touch to tx_priv anymore */
@@ -545,8 +782,6 @@ void wfx_flush(struct ieee80211_hw *hw, struct ieee80211_vif *vif, u32 queues, b
 	struct wfx_dev *wdev = hw->priv;
 	struct sk_buff_head dropped;
 	struct wfx_vif *wvif;
-	struct wfx_hif_msg *hif;
-	struct sk_buff *skb;
 
 	skb_queue_head_init(&dropped);
 	if (vif) {
@@ -560,10 +795,39 @@ void wfx_flush(struct ieee80211_hw *hw, struct ieee80211_vif *vif, u32 queues, b
 	wfx_tx_flush(wdev);
 	if (wdev->chip_frozen)
 		wfx_pending_drop(wdev, &dropped);
-	while ((skb = skb_dequeue(&dropped)) != NULL) {
+	wfx_tx_drop(wdev, &dropped);
+}
+
+/* Give back to mac80211 frames that won't be sent */
+void wfx_tx_drop(struct wfx_dev *wdev, struct sk_buff_head *dropped)
+{
+	struct wfx_vif *wvif;
+	struct wfx_hif_msg *hif;
+	struct sk_buff *skb;
+
+	while ((skb = skb_dequeue(dropped)) != NULL) {
 		hif = (struct wfx_hif_msg *)skb->data;
 		wvif = wdev_to_wvif(wdev, hif->interface);
 		ieee80211_tx_info_clear_status(IEEE80211_SKB_CB(skb));
 		wfx_skb_dtor(wvif, skb);
 	}
 }
+
+/* Frames carry their own lifetime. The MIB only provides the default value used by the firmware
+ * for the frames without lifetime. Use the lifetime of BE. The MIB is left untouched while no
+ * lifetime is set for BE. If this lifetime is removed, restore the value recommended by 802.11
+ * (512 TUs).
+ */
+void wfx_tx_lifetime_apply(struct wfx_vif *wvif)
+{
+	u32 lifetime = READ_ONCE(wvif->wdev->tx_lifetime[IEEE80211_AC_BE]);
+
+	if (lifetime) {
+		wfx_hif_max_tx_msdu_lifetime(wvif,
+					     DIV_ROUND_UP(lifetime * USEC_PER_MSEC, USEC_PER_TU));
+		wvif->tx_lifetime_mib = true;
+	} else if (wvif->tx_lifetime_mib) {
+		wfx_hif_max_tx_msdu_lifetime(wvif, 512);
+		wvif->tx_lifetime_mib = false;
+	}
+}
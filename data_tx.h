@@ -14,6 +14,9 @@
 #include "hif_api_cmd.h"
 #include "hif_api_mib.h"
 
+/* Larger lifetimes (in ms) are refused. So, the conversion to us does not overflow. */
+#define WFX_TX_LIFETIME_MAX 60000
+
 struct wfx_tx_priv;
 struct wfx_dev;
 struct wfx_vif;
@@ -23,6 +26,7 @@ struct wfx_tx_policy {
 	int usage_count;
 	u8 rates[12];
 	bool uploaded;
+	unsigned int generation; /* incremented each time the entry is recycled */
 };
 
 struct wfx_tx_policy_cache {
@@ -31,18 +35,29 @@ struct wfx_tx_policy_cache {
 	struct list_head used;
 	struct list_head free;
 	spinlock_t lock;
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int evictions;
 };
 
 struct wfx_tx_priv {
 	ktime_t xmit_timestamp;
+	ktime_t deadline; /* 0 if the frame never expires */
 	unsigned char icv_size;
+	unsigned char pending_lookups;
 };
 
 void wfx_tx_policy_init(struct wfx_vif *wvif);
 void wfx_tx_policy_upload_work(struct work_struct *work);
+void wfx_tx_policy_preload(struct wfx_vif *wvif, struct ieee80211_sta *sta);
+bool wfx_tx_policy_is_ready(struct wfx_dev *wdev, struct sk_buff *skb);
 
 void wfx_tx(struct ieee80211_hw *hw, struct ieee80211_tx_control *control, struct sk_buff *skb);
+void wfx_wake_tx_queue(struct ieee80211_hw *hw, struct ieee80211_txq *txq);
+void wfx_tx_pull_txqs(struct wfx_dev *wdev);
 void wfx_tx_confirm_cb(struct wfx_dev *wdev, const struct wfx_hif_cnf_tx *arg);
+void wfx_tx_drop(struct wfx_dev *wdev, struct sk_buff_head *dropped);
+void wfx_tx_lifetime_apply(struct wfx_vif *wvif);
 void wfx_flush(struct ieee80211_hw *hw, struct ieee80211_vif *vif, u32 queues, bool drop);
 
 static inline struct wfx_tx_priv *wfx_skb_tx_priv(struct sk_buff *skb)
@@ -8,12 +8,14 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/crc32.h>
+#include <linux/sched.h>
 
 #include "debug.h"
 #include "wfx.h"
 #include "sta.h"
 #include "main.h"
 #include "hif_tx.h"
+#include "bus.h"
 #include "hif_tx_mib.h"
 
 #define CREATE_TRACE_POINTS
@@ -202,6 +204,332 @@ static int wfx_tx_power_loop_show(struct seq_file *seq, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(wfx_tx_power_loop);
 
+static const char * const ac_names[] = {
+	[IEEE80211_AC_VO] = "VO",
+	[IEEE80211_AC_VI] = "VI",
+	[IEEE80211_AC_BE] = "BE",
+	[IEEE80211_AC_BK] = "BK",
+};
+
+static int wfx_tx_lifetime_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	int i;
+
+	for (i = 0; i < IEEE80211_NUM_ACS; i++)
+		seq_printf(seq, "%s: %ums\n", ac_names[i], wdev->tx_lifetime[i]);
+	return 0;
+}
+
+static int wfx_tx_lifetime_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wfx_tx_lifetime_show, inode->i_private);
+}
+
+/* Expect the lifetimes (in ms) of VO, VI, BE and BK separated by spaces */
+static ssize_t wfx_tx_lifetime_write(struct file *file, const char __user *user_buf,
+				     size_t count, loff_t *ppos)
+{
+	struct wfx_dev *wdev = ((struct seq_file *)file->private_data)->private;
+	u32 val[IEEE80211_NUM_ACS];
+	struct wfx_vif *wvif;
+	char buf[64];
+	int i;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, user_buf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	if (sscanf(buf, "%u %u %u %u", &val[0], &val[1], &val[2], &val[3]) != ARRAY_SIZE(val))
+		return -EINVAL;
+	for (i = 0; i < IEEE80211_NUM_ACS; i++)
+		if (val[i] > WFX_TX_LIFETIME_MAX)
+			return -EINVAL;
+
+	mutex_lock(&wdev->conf_mutex);
+	for (i = 0; i < IEEE80211_NUM_ACS; i++)
+		WRITE_ONCE(wdev->tx_lifetime[i], val[i]);
+	wvif = NULL;
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL)
+		wfx_tx_lifetime_apply(wvif);
+	mutex_unlock(&wdev->conf_mutex);
+	return count;
+}
+
+static const struct file_operations wfx_tx_lifetime_fops = {
+	.open = wfx_tx_lifetime_open,
+	.read = seq_read,
+	.write = wfx_tx_lifetime_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int wfx_tx_queues_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_queue *queue;
+	struct wfx_vif *wvif;
+	int i;
+
+	seq_printf(seq, "%-11s %12s %12s %12s %12s %12s\n", "", "expired drv", "expired fw",
+		   "more", "aggregated", "txop limit");
+	wvif = NULL;
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
+		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
+			queue = &wvif->tx_queue[i];
+			seq_printf(seq, "iface %d %s %12d %12d %12d %12d %12d\n",
+				   wvif->id, ac_names[i],
+				   atomic_read(&queue->expired_drv),
+				   atomic_read(&queue->expired_fw),
+				   atomic_read(&queue->tx_more),
+				   atomic_read(&queue->cnf_aggr),
+				   atomic_read(&queue->cnf_txop_limit));
+		}
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_tx_queues);
+
+static int wfx_tx_policies_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_tx_policy_cache *cache;
+	struct wfx_tx_policy *policy;
+	struct wfx_vif *wvif;
+	int i;
+
+	wvif = NULL;
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
+		cache = &wvif->tx_policy_cache;
+		spin_lock_bh(&cache->lock);
+		seq_printf(seq, "iface %d: hits: %u, misses: %u, evictions: %u\n", wvif->id,
+			   cache->hits, cache->misses, cache->evictions);
+		for (i = 0; i < ARRAY_SIZE(cache->cache); i++) {
+			policy = &cache->cache[i];
+			if (!memzcmp(policy->rates, sizeof(policy->rates)))
+				continue;
+			seq_printf(seq, "  %2d: %*phN users: %d%s\n", i,
+				   (int)sizeof(policy->rates), policy->rates, policy->usage_count,
+				   policy->uploaded ? "" : " (not uploaded)");
+		}
+		spin_unlock_bh(&cache->lock);
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_tx_policies);
+
+static void wfx_hif_stats_print(struct seq_file *seq, const char *name,
+				const struct wfx_hif_cmd_stats *stats)
+{
+	int i;
+
+	seq_printf(seq, "%-32s %8u %10llu %10llu", name, stats->count,
+		   stats->bytes_req, stats->bytes_cnf);
+	for (i = 0; i < WFX_HIF_STATS_BUCKETS; i++)
+		seq_printf(seq, " %6u", stats->latency[i]);
+	seq_puts(seq, "\n");
+}
+
+static int wfx_hif_stats_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_hif_cmd *hif_cmd = &wdev->hif_cmd;
+	int i;
+
+	seq_printf(seq, "%-32s %8s %10s %10s", "", "count", "bytes req", "bytes cnf");
+	for (i = 0; i < WFX_HIF_STATS_BUCKETS; i++)
+		seq_printf(seq, " %5luu", BIT(i + 1));
+	seq_puts(seq, "\n");
+	spin_lock_bh(&hif_cmd->stats_lock);
+	for (i = 0; i < ARRAY_SIZE(hif_cmd->stats); i++)
+		if (hif_cmd->stats[i].count)
+			wfx_hif_stats_print(seq, wfx_get_hif_name(i), &hif_cmd->stats[i]);
+	for (i = 0; i < ARRAY_SIZE(hif_cmd->stats_mib); i++)
+		if (hif_cmd->stats_mib[i].count)
+			wfx_hif_stats_print(seq, wfx_get_mib_name(0x2000 + i),
+					    &hif_cmd->stats_mib[i]);
+	spin_unlock_bh(&hif_cmd->stats_lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_hif_stats);
+
+static int wfx_bus_block_size_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_bus_calib *result;
+	int i;
+
+	seq_printf(seq, "current: %u\n", wdev->hwbus_ops->get_block_size(wdev->hwbus_priv));
+	for (i = 0; i < ARRAY_SIZE(wdev->bus_calib); i++) {
+		result = &wdev->bus_calib[i];
+		if (!result->block_size)
+			continue;
+		if (result->ret)
+			seq_printf(seq, "%4u: error %d\n", result->block_size, result->ret);
+		else
+			seq_printf(seq, "%4u: write %uus, read %uus\n", result->block_size,
+				   result->write_us, result->read_us);
+	}
+	return 0;
+}
+
+static int wfx_bus_block_size_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wfx_bus_block_size_show, inode->i_private);
+}
+
+/* The new block size must not make the requests larger than the buffers allocated during probe
+ * and the padding must fit in the skbs (see wfx_bus_block_size_valid())
+ */
+static ssize_t wfx_bus_block_size_write(struct file *file, const char __user *user_buf,
+					size_t count, loff_t *ppos)
+{
+	struct wfx_dev *wdev = ((struct seq_file *)file->private_data)->private;
+	const struct wfx_hwbus_ops *ops = wdev->hwbus_ops;
+	unsigned int val, prev;
+	size_t len;
+	int ret;
+
+	ret = kstrtouint_from_user(user_buf, count, 0, &val);
+	if (ret)
+		return ret;
+	if (!wfx_bus_block_size_valid(val))
+		return -EINVAL;
+
+	ops->lock(wdev->hwbus_priv);
+	prev = ops->get_block_size(wdev->hwbus_priv);
+	ret = ops->set_block_size(wdev->hwbus_priv, val);
+	if (!ret) {
+		len = ops->align_size(wdev->hwbus_priv, le16_to_cpu(wdev->hw_caps.size_inp_ch_buf));
+		if (len > wdev->hif_cmd.arena_slot_size) {
+			ops->set_block_size(wdev->hwbus_priv, prev);
+			ret = -EINVAL;
+		}
+	}
+	ops->unlock(wdev->hwbus_priv);
+	return ret ? ret : count;
+}
+
+static const struct file_operations wfx_bus_block_size_fops = {
+	.open = wfx_bus_block_size_open,
+	.read = seq_read,
+	.write = wfx_bus_block_size_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int wfx_wakeup_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_hif *hif = &wdev->hif;
+
+	seq_printf(seq, "wake-ups: %u\n", hif->wakeup_count);
+	seq_printf(seq, "avoided: %u\n", hif->wakeup_saved);
+	seq_printf(seq, "retries: %u\n", hif->wakeup_retries);
+	seq_printf(seq, "average delay: %llu us\n",
+		   hif->wakeup_count ? div_u64(hif->wakeup_total_us, hif->wakeup_count) : 0);
+	seq_printf(seq, "max delay: %lld us\n", hif->wakeup_max_us);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_wakeup);
+
+static int wfx_bh_sched_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_hif *hif = &wdev->hif;
+	struct task_struct *task = hif->worker ? hif->worker->task : NULL;
+
+	if (task) {
+		seq_printf(seq, "executor: thread (pid %d)\n", task_pid_nr(task));
+		seq_printf(seq, "policy: %s\n", task->policy == SCHED_FIFO ? "fifo" : "normal");
+		seq_printf(seq, "priority: %d\n", task->rt_priority);
+		seq_printf(seq, "nice: %d\n", task_nice(task));
+		seq_printf(seq, "cpus: %*pbl\n", cpumask_pr_args(task->cpus_ptr));
+	} else {
+		seq_puts(seq, "executor: workqueue\n");
+	}
+	seq_printf(seq, "runs: %u\n", hif->sched_count);
+	seq_printf(seq, "average latency: %llu us\n",
+		   hif->sched_count ? div_u64(hif->sched_total_us, hif->sched_count) : 0);
+	seq_printf(seq, "max latency: %lld us\n", hif->sched_max_us);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_bh_sched);
+
+static int wfx_bh_hist_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_hif *hif = &wdev->hif;
+	int i;
+
+	seq_printf(seq, "%-16s", "");
+	for (i = 0; i < WFX_BH_HIST_BUCKETS; i++)
+		seq_printf(seq, " %7s%-3lu", "<", BIT(i));
+	seq_puts(seq, "\n");
+	seq_printf(seq, "%-16s", "msgs per loop");
+	for (i = 0; i < WFX_BH_HIST_BUCKETS; i++)
+		seq_printf(seq, " %10u", hif->hist_msgs_per_loop[i]);
+	seq_puts(seq, "\n");
+	seq_printf(seq, "%-16s", "loops per run");
+	for (i = 0; i < WFX_BH_HIST_BUCKETS; i++)
+		seq_printf(seq, " %10u", hif->hist_loops_per_run[i]);
+	seq_puts(seq, "\n");
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_bh_hist);
+
+static int wfx_bh_poll_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_hif *hif = &wdev->hif;
+
+	seq_printf(seq, "max window: %u us\n", wdev->bh_poll_max_us);
+	seq_printf(seq, "window: %u us\n", READ_ONCE(hif->poll_window_us));
+	seq_printf(seq, "hits: %u\n", hif->poll_hits);
+	seq_printf(seq, "misses: %u\n", hif->poll_misses);
+	seq_printf(seq, "deferred IRQs: %u\n", hif->poll_deferred_irqs);
+	seq_printf(seq, "rescued: %u\n", hif->poll_rescued);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_bh_poll);
+
+static int wfx_rx_napi_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+
+	seq_printf(seq, "frames: %llu\n", wdev->rx_napi_frames);
+	seq_printf(seq, "bytes: %llu\n", wdev->rx_napi_bytes);
+	seq_printf(seq, "polls: %u\n", wdev->rx_napi_polls);
+	seq_printf(seq, "budget exhausted: %u\n", wdev->rx_napi_budget_exhausted);
+	seq_printf(seq, "drops: %u\n", wdev->rx_napi_drops);
+	seq_printf(seq, "queued: %u\n", skb_queue_len(&wdev->rx_napi_queue));
+	seq_printf(seq, "average time per frame: %llu ns\n",
+		   wdev->rx_napi_frames ?
+		   div64_u64(wdev->rx_napi_time_ns, wdev->rx_napi_frames) : 0);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_rx_napi);
+
+static int wfx_mib_cache_show(struct seq_file *seq, void *v)
+{
+	struct wfx_dev *wdev = seq->private;
+	struct wfx_hif_mib_cache *cache = &wdev->mib_cache;
+	int i, j;
+
+	spin_lock_bh(&cache->lock);
+	seq_printf(seq, "written: %u, skipped: %u\n", cache->written, cache->skipped);
+	for (i = 0; i < ARRAY_SIZE(cache->entries); i++)
+		for (j = 0; j < ARRAY_SIZE(cache->entries[i]); j++)
+			if (cache->entries[i][j].skipped)
+				seq_printf(seq, "iface %d %-32s skipped: %u\n", i,
+					   wfx_get_mib_name(wfx_hif_mib_cache_ids[j]),
+					   cache->entries[i][j].skipped);
+	spin_unlock_bh(&cache->lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wfx_mib_cache);
+
 static ssize_t wfx_send_pds_write(struct file *file, const char __user *user_buf,
 				  size_t count, loff_t *ppos)
 {
@@ -322,8 +650,29 @@ int wfx_debug_init(struct wfx_dev *wdev)
 
 	d = debugfs_create_dir("wfx", wdev->hw->wiphy->debugfsdir);
 	debugfs_create_file("counters", 0444, d, wdev, &wfx_counters_fops);
+	debugfs_create_file("hif_stats", 0444, d, wdev, &wfx_hif_stats_fops);
 	debugfs_create_file("rx_stats", 0444, d, wdev, &wfx_rx_stats_fops);
 	debugfs_create_file("tx_power_loop", 0444, d, wdev, &wfx_tx_power_loop_fops);
+	debugfs_create_file("tx_lifetime", 0600, d, wdev, &wfx_tx_lifetime_fops);
+	debugfs_create_file("tx_queues", 0444, d, wdev, &wfx_tx_queues_fops);
+	debugfs_create_file("tx_policies", 0444, d, wdev, &wfx_tx_policies_fops);
+	debugfs_create_file("mib_cache", 0444, d, wdev, &wfx_mib_cache_fops);
+	if (wdev->hwbus_ops->set_block_size)
+		debugfs_create_file("bus_block_size", 0600, d, wdev, &wfx_bus_block_size_fops);
+	debugfs_create_file("rx_napi", 0444, d, wdev, &wfx_rx_napi_fops);
+	debugfs_create_u32("rx_skb_fallbacks", 0444, d, &wdev->hif.rx_skb_fallbacks);
+	debugfs_create_u32("rx_msgs_no_skb", 0444, d, &wdev->hif.rx_msgs_no_skb);
+	debugfs_create_u32("tx_copy_room", 0444, d, &wdev->tx_copy_room);
+	debugfs_create_u32("tx_copy_nonlinear", 0444, d, &wdev->tx_copy_nonlinear);
+	debugfs_create_u32("bus_sessions", 0444, d, &wdev->bus_sessions);
+	debugfs_create_u32("bus_session_yields", 0444, d, &wdev->bus_session_yields);
+	debugfs_create_u32("bus_session_xfers", 0444, d, &wdev->bus_session_xfers);
+	debugfs_create_file("wakeup", 0444, d, wdev, &wfx_wakeup_fops);
+	debugfs_create_u32("keep_awake_ms", 0600, d, &wdev->keep_awake_ms);
+	debugfs_create_file("bh_sched", 0444, d, wdev, &wfx_bh_sched_fops);
+	debugfs_create_file("bh_hist", 0444, d, wdev, &wfx_bh_hist_fops);
+	debugfs_create_file("bh_poll", 0444, d, wdev, &wfx_bh_poll_fops);
+	debugfs_create_u32("hif_arena_fallbacks", 0444, d, &wdev->hif_cmd.arena_fallbacks);
 	debugfs_create_file("send_pds", 0200, d, wdev, &wfx_send_pds_fops);
 	debugfs_create_file("send_hif_msg", 0600, d, wdev, &wfx_send_hif_msg_fops);
 
@@ -13,6 +13,7 @@
 #include "fwio.h"
 #include "wfx.h"
 #include "hwio.h"
+#include "bus.h"
 
 /* Addresses below are in SRAM area */
 #define WFX_DNLD_FIFO             0x09004000
@@ -315,6 +316,96 @@ static int init_gpr(struct wfx_dev *wdev)
 	return 0;
 }
 
+static const unsigned int wfx_bus_calib_block_sizes[WFX_BUS_CALIB_NUM] = {
+	32, 64, 128, 256, 512
+};
+
+/* Typical sizes of the messages: confirmations, small frames, medium frames and MTU-sized frames */
+static const size_t wfx_bus_calib_lens[] = { 32, 128, 512, 1564 };
+
+#define WFX_BUS_CALIB_LOOPS 8
+
+/* Measure the time needed to write and read the messages of wfx_bus_calib_lens[] with the current
+ * block size. The download FIFO is used as a scratch area (the firmware is not yet loaded).
+ */
+static int wfx_bus_calib_run(struct wfx_dev *wdev, u8 *buf, size_t buf_len,
+			     struct wfx_bus_calib *result)
+{
+	ktime_t start;
+	size_t len;
+	int i, j, ret;
+
+	result->write_us = 0;
+	result->read_us = 0;
+	for (i = 0; i < ARRAY_SIZE(wfx_bus_calib_lens); i++) {
+		len = wdev->hwbus_ops->align_size(wdev->hwbus_priv, wfx_bus_calib_lens[i]);
+		if (len > buf_len)
+			return -EINVAL;
+		start = ktime_get();
+		for (j = 0; j < WFX_BUS_CALIB_LOOPS; j++) {
+			memset(buf, i + j, len);
+			ret = wfx_sram_buf_write(wdev, WFX_DNLD_FIFO, buf, len);
+			if (ret < 0)
+				return ret;
+		}
+		result->write_us += ktime_us_delta(ktime_get(), start);
+		start = ktime_get();
+		for (j = 0; j < WFX_BUS_CALIB_LOOPS; j++) {
+			ret = wfx_sram_buf_read(wdev, WFX_DNLD_FIFO, buf, len);
+			if (ret < 0)
+				return ret;
+		}
+		result->read_us += ktime_us_delta(ktime_get(), start);
+		if (memchr_inv(buf, i + WFX_BUS_CALIB_LOOPS - 1, len))
+			return -EIO;
+	}
+	return 0;
+}
+
+/* The best block size depends on the host controller. Try all of them and keep the fastest. */
+static void wfx_bus_calibrate(struct wfx_dev *wdev)
+{
+	const size_t buf_len = 2048;
+	struct wfx_bus_calib *result, *best = NULL;
+	unsigned int orig_size;
+	u8 *buf;
+	int i;
+
+	buf = kmalloc(buf_len, GFP_KERNEL);
+	if (!buf)
+		return;
+	orig_size = wdev->hwbus_ops->get_block_size(wdev->hwbus_priv);
+	for (i = 0; i < ARRAY_SIZE(wfx_bus_calib_block_sizes); i++) {
+		result = &wdev->bus_calib[i];
+		result->block_size = wfx_bus_calib_block_sizes[i];
+		if (!wfx_bus_block_size_valid(result->block_size)) {
+			result->ret = -ERANGE;
+			continue;
+		}
+		wdev->hwbus_ops->lock(wdev->hwbus_priv);
+		result->ret = wdev->hwbus_ops->set_block_size(wdev->hwbus_priv,
+							      result->block_size);
+		wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+		if (!result->ret)
+			result->ret = wfx_bus_calib_run(wdev, buf, buf_len, result);
+		if (result->ret)
+			continue;
+		dev_dbg(wdev->dev, "block size %u: write %uus, read %uus\n",
+			result->block_size, result->write_us, result->read_us);
+		if (!best || result->write_us + result->read_us < best->write_us + best->read_us)
+			best = result;
+	}
+	kfree(buf);
+	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wdev->hwbus_ops->set_block_size(wdev->hwbus_priv, best ? best->block_size : orig_size);
+	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	if (best)
+		dev_info(wdev->dev, "use bus block size of %u bytes\n", best->block_size);
+	else
+		dev_warn(wdev->dev, "bus calibration failed, keep block size of %u bytes\n",
+			 orig_size);
+}
+
 int wfx_init_device(struct wfx_dev *wdev)
 {
 	int ret;
@@ -374,6 +465,10 @@ int wfx_init_device(struct wfx_dev *wdev)
 	}
 	dev_dbg(wdev->dev, "chip wake up after %lldus\n", ktime_us_delta(now, start));
 
+	/* The CPU of the chip is still in reset, so the SRAM can be used freely */
+	if (wdev->calibrate_bus && wdev->hwbus_ops->set_block_size)
+		wfx_bus_calibrate(wdev);
+
 	ret = wfx_config_reg_write_bits(wdev, CFG_CPU_RESET, 0);
 	if (ret < 0)
 		return ret;
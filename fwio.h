@@ -10,6 +10,16 @@
 
 struct wfx_dev;
 
+/* Number of block sizes tried by the bus calibration */
+#define WFX_BUS_CALIB_NUM 5
+
+struct wfx_bus_calib {
+	unsigned int block_size;
+	unsigned int write_us;
+	unsigned int read_us;
+	int ret;
+};
+
 int wfx_init_device(struct wfx_dev *wdev);
 
 #endif
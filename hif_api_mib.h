@@ -200,6 +200,16 @@ struct wfx_hif_mib_wep_default_key_id {
 	u8     reserved[3];
 } __packed;
 
+struct wfx_hif_mib_override_int_rate {
+	u8     internal_tx_rate;
+	u8     non_erp_internal_tx_rate;
+	u8     reserved[2];
+} __packed;
+
+struct wfx_hif_mib_dot11_max_transmit_msdu_lifetime {
+	__le32 max_life_time;
+} __packed;
+
 struct wfx_hif_mib_dot11_rts_threshold {
 	__le32 threshold;
 } __packed;
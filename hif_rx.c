@@ -16,36 +16,23 @@
 #include "data_rx.h"
 #include "hif_api_cmd.h"
 
-static int wfx_hif_generic_confirm(struct wfx_dev *wdev,
+static int wfx_hif_generic_confirm(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req,
 				   const struct wfx_hif_msg *hif, const void *buf)
 {
 	/* All confirm messages start with status */
 	int status = le32_to_cpup((__le32 *)buf);
-	int cmd = hif->id;
 	int len = le16_to_cpu(hif->len) - 4; /* drop header */
 
-	WARN(!mutex_is_locked(&wdev->hif_cmd.lock), "data locking error");
-
-	if (!wdev->hif_cmd.buf_send) {
-		dev_warn(wdev->dev, "unexpected confirmation: 0x%.2x\n", cmd);
-		return -EINVAL;
-	}
-
-	if (cmd != wdev->hif_cmd.buf_send->id) {
-		dev_warn(wdev->dev, "chip response mismatch request: 0x%.2x vs 0x%.2x\n",
-			 cmd, wdev->hif_cmd.buf_send->id);
-		return -EINVAL;
-	}
-
-	if (wdev->hif_cmd.buf_recv) {
-		if (wdev->hif_cmd.len_recv >= len && len > 0)
-			memcpy(wdev->hif_cmd.buf_recv, buf, len);
+	if (req->buf_recv) {
+		if (req->len_recv >= len && len > 0)
+			memcpy(req->buf_recv, buf, len);
 		else
 			status = -EIO;
 	}
-	wdev->hif_cmd.ret = status;
+	req->ret = status;
+	req->len_cnf = le16_to_cpu(hif->len);
 
-	complete(&wdev->hif_cmd.done);
+	wfx_cmd_done(wdev, req);
 	return status;
 }
 
@@ -358,34 +345,40 @@ static const struct {
 	//{ HIF_IND_ID_RX,              wfx_hif_receive_indication },
 };
 
-void wfx_handle_rx(struct wfx_dev *wdev, struct sk_buff *skb)
+/* Only the received frames need a skb. The other messages are handled from the Rx buffer. */
+void wfx_handle_rx_msg(struct wfx_dev *wdev, const struct wfx_hif_msg *hif)
 {
 	int i;
-	const struct wfx_hif_msg *hif = (const struct wfx_hif_msg *)skb->data;
+	struct wfx_hif_cmd_req *req;
 	int hif_id = hif->id;
 
-	if (hif_id == HIF_IND_ID_RX) {
-		/* wfx_hif_receive_indication take care of skb lifetime */
-		wfx_hif_receive_indication(wdev, hif, hif->body, skb);
+	req = wfx_cmd_get_sent(wdev, hif_id);
+	if (req) {
+		wfx_hif_generic_confirm(wdev, req, hif, hif->body);
 		return;
 	}
-	/* Note: mutex_is_lock cause an implicit memory barrier that protect buf_send */
-	if (mutex_is_locked(&wdev->hif_cmd.lock) &&
-	    wdev->hif_cmd.buf_send && wdev->hif_cmd.buf_send->id == hif_id) {
-		wfx_hif_generic_confirm(wdev, hif, hif->body);
-		goto free;
-	}
 	for (i = 0; i < ARRAY_SIZE(hif_handlers); i++) {
 		if (hif_handlers[i].msg_id == hif_id) {
 			if (hif_handlers[i].handler)
 				hif_handlers[i].handler(wdev, hif, hif->body);
-			goto free;
+			return;
 		}
 	}
 	if (hif_id & HIF_ID_IS_INDICATION)
 		dev_err(wdev->dev, "unsupported HIF indication: ID %02x\n", hif_id);
 	else
 		dev_err(wdev->dev, "unexpected HIF confirmation: ID %02x\n", hif_id);
-free:
+}
+
+void wfx_handle_rx(struct wfx_dev *wdev, struct sk_buff *skb)
+{
+	const struct wfx_hif_msg *hif = (const struct wfx_hif_msg *)skb->data;
+
+	if (hif->id == HIF_IND_ID_RX) {
+		/* wfx_hif_receive_indication take care of skb lifetime */
+		wfx_hif_receive_indication(wdev, hif, hif->body, skb);
+		return;
+	}
+	wfx_handle_rx_msg(wdev, hif);
 	dev_kfree_skb(skb);
 }
@@ -10,8 +10,10 @@
 #define WFX_HIF_RX_H
 
 struct wfx_dev;
+struct wfx_hif_msg;
 struct sk_buff;
 
 void wfx_handle_rx(struct wfx_dev *wdev, struct sk_buff *skb);
+void wfx_handle_rx_msg(struct wfx_dev *wdev, const struct wfx_hif_msg *hif);
 
 #endif
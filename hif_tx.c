@@ -7,6 +7,7 @@
  * Copyright (c) 2010, ST-Ericsson
  */
 #include <linux/etherdevice.h>
+#include <linux/dma-mapping.h>
 
 #include "hif_tx.h"
 #include "wfx.h"
@@ -17,9 +18,177 @@
 
 void wfx_init_hif_cmd(struct wfx_hif_cmd *hif_cmd)
 {
-	init_completion(&hif_cmd->ready);
-	init_completion(&hif_cmd->done);
 	mutex_init(&hif_cmd->lock);
+	spin_lock_init(&hif_cmd->queue_lock);
+	INIT_LIST_HEAD(&hif_cmd->queued);
+	INIT_LIST_HEAD(&hif_cmd->sent);
+	init_waitqueue_head(&hif_cmd->idle);
+	spin_lock_init(&hif_cmd->arena_lock);
+	spin_lock_init(&hif_cmd->stats_lock);
+}
+
+/* Requests are built in preallocated buffers large enough for any message accepted by the chip.
+ * Memory returned by kmalloc() is DMA-safe and each slot is aligned on a cache line.
+ */
+int wfx_hif_arena_init(struct wfx_dev *wdev)
+{
+	struct wfx_hif_cmd *hif_cmd = &wdev->hif_cmd;
+	size_t len = le16_to_cpu(wdev->hw_caps.size_inp_ch_buf);
+
+	BUILD_BUG_ON(WFX_HIF_ARENA_SLOTS > BITS_PER_LONG);
+	len = wdev->hwbus_ops->align_size(wdev->hwbus_priv, len);
+	len = ALIGN(len, dma_get_cache_alignment());
+	hif_cmd->arena = devm_kcalloc(wdev->dev, WFX_HIF_ARENA_SLOTS, len, GFP_KERNEL);
+	if (!hif_cmd->arena)
+		return -ENOMEM;
+	hif_cmd->arena_slot_size = len;
+	hif_cmd->arena_free = GENMASK(WFX_HIF_ARENA_SLOTS - 1, 0);
+	return 0;
+}
+
+/* Fall back to kzalloc() if the arena is exhausted or not yet allocated */
+void *wfx_hif_buf_alloc(struct wfx_dev *wdev, size_t len)
+{
+	struct wfx_hif_cmd *hif_cmd = &wdev->hif_cmd;
+	void *buf = NULL;
+	int slot;
+
+	if (hif_cmd->arena && len <= hif_cmd->arena_slot_size) {
+		spin_lock_bh(&hif_cmd->arena_lock);
+		if (hif_cmd->arena_free) {
+			slot = __ffs(hif_cmd->arena_free);
+			hif_cmd->arena_free &= ~BIT(slot);
+			buf = hif_cmd->arena + slot * hif_cmd->arena_slot_size;
+		} else {
+			hif_cmd->arena_fallbacks++;
+		}
+		spin_unlock_bh(&hif_cmd->arena_lock);
+	}
+	if (buf) {
+		memset(buf, 0, len);
+		return buf;
+	}
+	return kzalloc(len, GFP_KERNEL);
+}
+
+/* Return the arena slot of buf, or -1 if buf has been allocated with kzalloc() */
+static int wfx_hif_buf_slot(struct wfx_hif_cmd *hif_cmd, const void *buf)
+{
+	const u8 *ptr = buf;
+
+	if (!hif_cmd->arena || ptr < hif_cmd->arena ||
+	    ptr >= hif_cmd->arena + WFX_HIF_ARENA_SLOTS * hif_cmd->arena_slot_size)
+		return -1;
+	return (ptr - hif_cmd->arena) / hif_cmd->arena_slot_size;
+}
+
+void wfx_hif_buf_free(struct wfx_dev *wdev, void *buf)
+{
+	struct wfx_hif_cmd *hif_cmd = &wdev->hif_cmd;
+	int slot = wfx_hif_buf_slot(hif_cmd, buf);
+
+	if (slot < 0) {
+		kfree(buf);
+		return;
+	}
+	spin_lock_bh(&hif_cmd->arena_lock);
+	WARN(hif_cmd->arena_free & BIT(slot), "double free of a request buffer");
+	hif_cmd->arena_free |= BIT(slot);
+	spin_unlock_bh(&hif_cmd->arena_lock);
+}
+
+/* The MIBs rewritten on each configuration change, often with the same value */
+const u16 wfx_hif_mib_cache_ids[WFX_MIB_CACHE_SIZE] = {
+	HIF_MIB_ID_CURRENT_TX_POWER_LEVEL,
+	HIF_MIB_ID_BEACON_WAKEUP_PERIOD,
+	HIF_MIB_ID_RCPI_RSSI_THRESHOLD,
+	HIF_MIB_ID_RX_FILTER,
+	HIF_MIB_ID_BEACON_FILTER_TABLE,
+	HIF_MIB_ID_BEACON_FILTER_ENABLE,
+	HIF_MIB_ID_GL_OPERATIONAL_POWER_MODE,
+	HIF_MIB_ID_BLOCK_ACK_POLICY,
+	HIF_MIB_ID_SET_ASSOCIATION_MODE,
+	HIF_MIB_ID_KEEP_ALIVE_PERIOD,
+	HIF_MIB_ID_ARP_IP_ADDRESSES_TABLE,
+	HIF_MIB_ID_SET_UAPSD_INFORMATION,
+	HIF_MIB_ID_NON_ERP_PROTECTION,
+	HIF_MIB_ID_SLOT_TIME,
+	HIF_MIB_ID_DOT11_RTS_THRESHOLD,
+	HIF_MIB_ID_DOT11_MAX_TRANSMIT_MSDU_LIFETIME,
+	HIF_MIB_ID_OVERRIDE_INTERNAL_TX_RATE,
+};
+
+void wfx_hif_mib_cache_init(struct wfx_hif_mib_cache *cache)
+{
+	spin_lock_init(&cache->lock);
+}
+
+static struct wfx_hif_mib_cache_entry *wfx_hif_mib_cache_entry(struct wfx_dev *wdev, int vif_id,
+								u16 mib_id)
+{
+	int i;
+
+	if (vif_id == -1)
+		vif_id = 2;
+	if (vif_id < 0 || vif_id > 2)
+		return NULL;
+	for (i = 0; i < ARRAY_SIZE(wfx_hif_mib_cache_ids); i++)
+		if (wfx_hif_mib_cache_ids[i] == mib_id)
+			return &wdev->mib_cache.entries[vif_id][i];
+	return NULL;
+}
+
+/* Return true if val is the last value written to the MIB. Else, remember it. */
+static bool wfx_hif_mib_cache_check(struct wfx_dev *wdev, int vif_id, u16 mib_id,
+				    const void *val, size_t val_len)
+{
+	struct wfx_hif_mib_cache_entry *entry = wfx_hif_mib_cache_entry(wdev, vif_id, mib_id);
+	struct wfx_hif_mib_cache *cache = &wdev->mib_cache;
+
+	if (!entry)
+		return false;
+	spin_lock_bh(&cache->lock);
+	if (entry->len && entry->len == val_len && !memcmp(entry->data, val, val_len)) {
+		entry->skipped++;
+		cache->skipped++;
+		spin_unlock_bh(&cache->lock);
+		return true;
+	}
+	if (val_len <= sizeof(entry->data)) {
+		memcpy(entry->data, val, val_len);
+		entry->len = val_len;
+	} else {
+		entry->len = 0;
+	}
+	cache->written++;
+	spin_unlock_bh(&cache->lock);
+	return false;
+}
+
+/* Forget the MIB value if the chip did not accept it */
+static void wfx_hif_mib_cache_invalidate(struct wfx_dev *wdev, int vif_id, u16 mib_id)
+{
+	struct wfx_hif_mib_cache_entry *entry = wfx_hif_mib_cache_entry(wdev, vif_id, mib_id);
+
+	if (!entry)
+		return;
+	spin_lock_bh(&wdev->mib_cache.lock);
+	entry->len = 0;
+	spin_unlock_bh(&wdev->mib_cache.lock);
+}
+
+/* Forget the values of vif_id (or of all the interfaces if vif_id is -1) */
+void wfx_hif_mib_cache_flush(struct wfx_dev *wdev, int vif_id)
+{
+	struct wfx_hif_mib_cache *cache = &wdev->mib_cache;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(cache->entries); i++) {
+		if (vif_id != -1 && vif_id != i)
+			continue;
+		for (j = 0; j < ARRAY_SIZE(cache->entries[i]); j++)
+			wfx_hif_mib_cache_invalidate(wdev, i, wfx_hif_mib_cache_ids[j]);
+	}
 }
 
 static void wfx_fill_header(struct wfx_hif_msg *hif, int if_id, unsigned int cmd, size_t size)
@@ -36,84 +205,310 @@ static void wfx_fill_header(struct wfx_hif_msg *hif, int if_id, unsigned int cmd
 	hif->interface = if_id;
 }
 
-static void *wfx_alloc_hif(size_t body_len, struct wfx_hif_msg **hif)
+static void *wfx_alloc_hif(struct wfx_dev *wdev, size_t body_len, struct wfx_hif_msg **hif)
 {
-	*hif = kzalloc(sizeof(struct wfx_hif_msg) + body_len, GFP_KERNEL);
+	*hif = wfx_hif_buf_alloc(wdev, sizeof(struct wfx_hif_msg) + body_len);
 	if (*hif)
 		return (*hif)->body;
 	else
 		return NULL;
 }
 
-int wfx_cmd_send(struct wfx_dev *wdev, struct wfx_hif_msg *request,
-		 void *reply, size_t reply_len, bool no_reply)
+static void wfx_free_hif(struct wfx_dev *wdev, struct wfx_hif_msg *hif)
+{
+	wfx_hif_buf_free(wdev, hif);
+}
+
+static void wfx_cmd_log(struct wfx_dev *wdev, struct wfx_hif_msg *request, int ret)
 {
 	const char *mib_name = "";
 	const char *mib_sep = "";
 	int cmd = request->id;
 	int vif = request->interface;
-	int ret;
 
-	/* Do not wait for any reply if chip is frozen */
-	if (wdev->chip_frozen)
-		return -ETIMEDOUT;
+	if (ret &&
+	    (cmd == HIF_REQ_ID_READ_MIB || cmd == HIF_REQ_ID_WRITE_MIB)) {
+		mib_name = wfx_get_mib_name(((u16 *)request)[2]);
+		mib_sep = "/";
+	}
+	if (ret < 0)
+		dev_err(wdev->dev, "hardware request %s%s%s (%#.2x) on vif %d returned error %d\n",
+			wfx_get_hif_name(cmd), mib_sep, mib_name, cmd, vif, ret);
+	if (ret > 0)
+		dev_warn(wdev->dev, "hardware request %s%s%s (%#.2x) on vif %d returned status %d\n",
+			 wfx_get_hif_name(cmd), mib_sep, mib_name, cmd, vif, ret);
+}
 
-	mutex_lock(&wdev->hif_cmd.lock);
-	WARN(wdev->hif_cmd.buf_send, "data locking error");
+static bool wfx_cmd_is_idle(struct wfx_dev *wdev)
+{
+	bool ret;
 
-	/* Note: call to complete() below has an implicit memory barrier that hopefully protect
-	 * buf_send
-	 */
-	wdev->hif_cmd.buf_send = request;
-	wdev->hif_cmd.buf_recv = reply;
-	wdev->hif_cmd.len_recv = reply_len;
-	complete(&wdev->hif_cmd.ready);
+	spin_lock_bh(&wdev->hif_cmd.queue_lock);
+	ret = list_empty(&wdev->hif_cmd.queued) && list_empty(&wdev->hif_cmd.sent) &&
+	      !wdev->hif_cmd.in_transit;
+	spin_unlock_bh(&wdev->hif_cmd.queue_lock);
+	return ret;
+}
 
+/* Complete all the requests with the error ret. The bh still uses the request it is sending, so
+ * this one is completed by wfx_cmd_sent().
+ */
+static void wfx_cmd_abort_all(struct wfx_dev *wdev, int ret)
+{
+	struct wfx_hif_cmd_req *req, *tmp;
+	LIST_HEAD(aborted);
+
+	spin_lock_bh(&wdev->hif_cmd.queue_lock);
+	list_splice_tail_init(&wdev->hif_cmd.sent, &aborted);
+	list_splice_tail_init(&wdev->hif_cmd.queued, &aborted);
+	if (wdev->hif_cmd.in_transit) {
+		wdev->hif_cmd.in_transit_abort = ret;
+		wdev->hif_cmd.num_sent = 1;
+	} else {
+		wdev->hif_cmd.num_sent = 0;
+	}
+	spin_unlock_bh(&wdev->hif_cmd.queue_lock);
+	list_for_each_entry_safe(req, tmp, &aborted, link) {
+		list_del(&req->link);
+		req->ret = ret;
+		req->complete(wdev, req);
+	}
+	wake_up(&wdev->hif_cmd.idle);
+}
+
+void wfx_cmd_queue(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req)
+{
+	req->queued = ktime_get();
+	mutex_lock(&wdev->hif_cmd.lock);
+	spin_lock_bh(&wdev->hif_cmd.queue_lock);
+	list_add_tail(&req->link, &wdev->hif_cmd.queued);
+	spin_unlock_bh(&wdev->hif_cmd.queue_lock);
+	mutex_unlock(&wdev->hif_cmd.lock);
 	wfx_bh_request_tx(wdev);
+}
 
-	if (no_reply) {
-		/* Chip won't reply. Ensure the wq has send the buffer before to continue. */
-		flush_workqueue(wdev->bh_wq);
-		ret = 0;
-		goto end;
+/* Called from the bh. Return the next request to send, if the chip can accept it. */
+struct wfx_hif_cmd_req *wfx_cmd_get_next(struct wfx_dev *wdev)
+{
+	struct wfx_hif_cmd_req *req = NULL;
+
+	if (list_empty_careful(&wdev->hif_cmd.queued))
+		return NULL;
+	spin_lock_bh(&wdev->hif_cmd.queue_lock);
+	if (!list_empty(&wdev->hif_cmd.queued) &&
+	    wdev->hif_cmd.num_sent < WFX_HIF_CMD_IN_FLIGHT_MAX) {
+		req = list_first_entry(&wdev->hif_cmd.queued, struct wfx_hif_cmd_req, link);
+		list_del_init(&req->link);
+		wdev->hif_cmd.in_transit = req;
+		wdev->hif_cmd.num_sent++;
 	}
+	spin_unlock_bh(&wdev->hif_cmd.queue_lock);
+	return req;
+}
 
-	if (wdev->poll_irq)
+/* Called from the bh once req has been sent. The request may have been aborted meanwhile. */
+void wfx_cmd_sent(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req)
+{
+	int ret = 0;
+
+	spin_lock_bh(&wdev->hif_cmd.queue_lock);
+	wdev->hif_cmd.in_transit = NULL;
+	if (wdev->hif_cmd.in_transit_abort) {
+		ret = wdev->hif_cmd.in_transit_abort;
+		wdev->hif_cmd.in_transit_abort = 0;
+	} else if (!req->no_reply) {
+		list_add_tail(&req->link, &wdev->hif_cmd.sent);
+		spin_unlock_bh(&wdev->hif_cmd.queue_lock);
+		return;
+	}
+	/* Aborted or the chip won't reply */
+	wdev->hif_cmd.num_sent--;
+	spin_unlock_bh(&wdev->hif_cmd.queue_lock);
+	req->ret = ret;
+	wfx_cmd_done(wdev, req);
+}
+
+/* The chip answers the requests in order. So, a confirmation belongs to the oldest request with the
+ * same ID.
+ */
+struct wfx_hif_cmd_req *wfx_cmd_get_sent(struct wfx_dev *wdev, int cmd)
+{
+	struct wfx_hif_cmd_req *req;
+
+	spin_lock_bh(&wdev->hif_cmd.queue_lock);
+	list_for_each_entry(req, &wdev->hif_cmd.sent, link) {
+		if (req->buf_send->id == cmd) {
+			list_del(&req->link);
+			wdev->hif_cmd.num_sent--;
+			spin_unlock_bh(&wdev->hif_cmd.queue_lock);
+			return req;
+		}
+	}
+	spin_unlock_bh(&wdev->hif_cmd.queue_lock);
+	return NULL;
+}
+
+static void wfx_cmd_stats_add(struct wfx_hif_cmd_stats *stats, struct wfx_hif_cmd_req *req,
+			      int bucket)
+{
+	stats->count++;
+	stats->bytes_req += le16_to_cpu(req->buf_send->len);
+	stats->bytes_cnf += req->len_cnf;
+	stats->latency[bucket]++;
+}
+
+static void wfx_cmd_update_stats(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req)
+{
+	struct wfx_hif_cmd *hif_cmd = &wdev->hif_cmd;
+	struct wfx_hif_msg *hif = req->buf_send;
+	s64 delay = ktime_us_delta(ktime_get(), req->queued);
+	int bucket = min(ilog2(max_t(s64, delay, 1)), WFX_HIF_STATS_BUCKETS - 1);
+	u16 mib_id = 0;
+
+	if (hif->id == HIF_REQ_ID_READ_MIB || hif->id == HIF_REQ_ID_WRITE_MIB)
+		mib_id = le16_to_cpu(((__le16 *)hif->body)[0]);
+	spin_lock_bh(&hif_cmd->stats_lock);
+	wfx_cmd_stats_add(&hif_cmd->stats[hif->id % ARRAY_SIZE(hif_cmd->stats)], req, bucket);
+	if (mib_id >= 0x2000 && mib_id < 0x2000 + ARRAY_SIZE(hif_cmd->stats_mib))
+		wfx_cmd_stats_add(&hif_cmd->stats_mib[mib_id - 0x2000], req, bucket);
+	spin_unlock_bh(&hif_cmd->stats_lock);
+}
+
+void wfx_cmd_done(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req)
+{
+	wfx_cmd_update_stats(wdev, req);
+	req->complete(wdev, req);
+	wake_up(&wdev->hif_cmd.idle);
+	/* A slot may be available for the next request */
+	if (!list_empty_careful(&wdev->hif_cmd.queued))
+		wfx_bh_request_tx(wdev);
+}
+
+static void wfx_cmd_complete_sync(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req)
+{
+	complete(&req->done);
+}
+
+int wfx_cmd_send(struct wfx_dev *wdev, struct wfx_hif_msg *request,
+		 void *reply, size_t reply_len, bool no_reply)
+{
+	struct wfx_hif_cmd_req req = {
+		.buf_send = request,
+		.buf_recv = reply,
+		.len_recv = reply_len,
+		.no_reply = no_reply,
+		.complete = wfx_cmd_complete_sync,
+	};
+	int ret;
+
+	/* Do not wait for any reply if chip is frozen */
+	if (wdev->chip_frozen)
+		return -ETIMEDOUT;
+
+	init_completion(&req.done);
+	wfx_cmd_queue(wdev, &req);
+
+	if (wdev->poll_irq && !no_reply)
 		wfx_bh_poll_irq(wdev);
 
-	ret = wait_for_completion_timeout(&wdev->hif_cmd.done, 1 * HZ);
+	ret = wait_for_completion_timeout(&req.done, 1 * HZ);
 	if (!ret) {
 		dev_err(wdev->dev, "chip is abnormally long to answer\n");
-		reinit_completion(&wdev->hif_cmd.ready);
-		ret = wait_for_completion_timeout(&wdev->hif_cmd.done, 3 * HZ);
+		ret = wait_for_completion_timeout(&req.done, 3 * HZ);
 	}
 	if (!ret) {
 		dev_err(wdev->dev, "chip did not answer\n");
 		wfx_pending_dump_old_frames(wdev, 3000);
 		wdev->chip_frozen = true;
-		reinit_completion(&wdev->hif_cmd.done);
+		wfx_cmd_abort_all(wdev, -ETIMEDOUT);
+		/* The request may be in transit. A bus transfer should end quickly, but do not hang
+		 * forever (often with conf_mutex held) if the bh is stuck.
+		 */
+		WARN(!wait_for_completion_timeout(&req.done, 1 * HZ),
+		     "request %#.2x is still used by the bh", request->id);
 		ret = -ETIMEDOUT;
 	} else {
-		ret = wdev->hif_cmd.ret;
+		ret = req.ret;
 	}
 
-end:
-	wdev->hif_cmd.buf_send = NULL;
-	mutex_unlock(&wdev->hif_cmd.lock);
+	wfx_cmd_log(wdev, request, ret);
+	return ret;
+}
 
-	if (ret &&
-	    (cmd == HIF_REQ_ID_READ_MIB || cmd == HIF_REQ_ID_WRITE_MIB)) {
-		mib_name = wfx_get_mib_name(((u16 *)request)[2]);
-		mib_sep = "/";
+/* The request of an asynchronous message uses the entry of async_reqs with the same index as the
+ * arena slot of the message.
+ */
+static struct wfx_hif_cmd_req *wfx_cmd_req_alloc(struct wfx_dev *wdev, struct wfx_hif_msg *request)
+{
+	int slot = wfx_hif_buf_slot(&wdev->hif_cmd, request);
+	struct wfx_hif_cmd_req *req;
+
+	if (slot < 0)
+		return kzalloc(sizeof(*req), GFP_KERNEL);
+	req = &wdev->hif_cmd.async_reqs[slot];
+	memset(req, 0, sizeof(*req));
+	return req;
+}
+
+static void wfx_cmd_req_free(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req)
+{
+	struct wfx_hif_cmd *hif_cmd = &wdev->hif_cmd;
+
+	if (req < hif_cmd->async_reqs || req >= hif_cmd->async_reqs + WFX_HIF_ARENA_SLOTS)
+		kfree(req);
+}
+
+static void wfx_cmd_complete_async(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req)
+{
+	struct wfx_hif_msg *request = req->buf_send;
+	struct wfx_hif_req_write_mib *body = (struct wfx_hif_req_write_mib *)request->body;
+
+	if (req->ret && request->id == HIF_REQ_ID_WRITE_MIB)
+		wfx_hif_mib_cache_invalidate(wdev, request->interface, le16_to_cpu(body->mib_id));
+	wfx_cmd_log(wdev, request, req->ret);
+	/* Release req first, since its entry is reused with the slot of the message */
+	wfx_cmd_req_free(wdev, req);
+	wfx_hif_buf_free(wdev, request);
+}
+
+/* Queue request and return immediately. The request is freed once the confirmation is received.
+ * Errors are only logged.
+ */
+int wfx_cmd_send_async(struct wfx_dev *wdev, struct wfx_hif_msg *request)
+{
+	struct wfx_hif_cmd_req *req;
+
+	if (wdev->chip_frozen) {
+		wfx_hif_buf_free(wdev, request);
+		return -ETIMEDOUT;
 	}
-	if (ret < 0)
-		dev_err(wdev->dev, "hardware request %s%s%s (%#.2x) on vif %d returned error %d\n",
-			wfx_get_hif_name(cmd), mib_sep, mib_name, cmd, vif, ret);
-	if (ret > 0)
-		dev_warn(wdev->dev, "hardware request %s%s%s (%#.2x) on vif %d returned status %d\n",
-			 wfx_get_hif_name(cmd), mib_sep, mib_name, cmd, vif, ret);
+	req = wfx_cmd_req_alloc(wdev, request);
+	if (!req) {
+		wfx_hif_buf_free(wdev, request);
+		return -ENOMEM;
+	}
+	req->buf_send = request;
+	req->complete = wfx_cmd_complete_async;
+	wfx_cmd_queue(wdev, req);
+	return 0;
+}
 
-	return ret;
+/* Wait until all the requests have been answered */
+int wfx_cmd_wait_idle(struct wfx_dev *wdev)
+{
+	if (wdev->chip_frozen) {
+		wfx_cmd_abort_all(wdev, -ETIMEDOUT);
+		return -ETIMEDOUT;
+	}
+	if (wdev->poll_irq)
+		wfx_bh_poll_irq(wdev);
+	if (!wait_event_timeout(wdev->hif_cmd.idle, wfx_cmd_is_idle(wdev), 4 * HZ)) {
+		dev_err(wdev->dev, "chip did not answer\n");
+		wdev->chip_frozen = true;
+		wfx_cmd_abort_all(wdev, -ETIMEDOUT);
+		return -ETIMEDOUT;
+	}
+	return 0;
 }
 
 /* This function is special. After HIF_REQ_ID_SHUT_DOWN, chip won't reply to any request anymore.
@@ -124,7 +519,7 @@ int wfx_hif_shutdown(struct wfx_dev *wdev)
 	int ret;
 	struct wfx_hif_msg *hif;
 
-	wfx_alloc_hif(0, &hif);
+	wfx_alloc_hif(wdev, 0, &hif);
 	if (!hif)
 		return -ENOMEM;
 	wfx_fill_header(hif, -1, HIF_REQ_ID_SHUT_DOWN, 0);
@@ -133,7 +528,7 @@ int wfx_hif_shutdown(struct wfx_dev *wdev)
 		gpiod_set_value(wdev->pdata.gpio_wakeup, 0);
 	else
 		wfx_control_reg_write(wdev, 0);
-	kfree(hif);
+	wfx_free_hif(wdev, hif);
 	return ret;
 }
 
@@ -142,7 +537,7 @@ int wfx_hif_configuration(struct wfx_dev *wdev, const u8 *conf, size_t len)
 	int ret;
 	size_t buf_len = sizeof(struct wfx_hif_req_configuration) + len;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_configuration *body = wfx_alloc_hif(buf_len, &hif);
+	struct wfx_hif_req_configuration *body = wfx_alloc_hif(wdev, buf_len, &hif);
 
 	if (!hif)
 		return -ENOMEM;
@@ -150,7 +545,7 @@ int wfx_hif_configuration(struct wfx_dev *wdev, const u8 *conf, size_t len)
 	memcpy(body->pds_data, conf, len);
 	wfx_fill_header(hif, -1, HIF_REQ_ID_CONFIGURATION, buf_len);
 	ret = wfx_cmd_send(wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wdev, hif);
 	return ret;
 }
 
@@ -158,14 +553,16 @@ int wfx_hif_reset(struct wfx_vif *wvif, bool reset_stat)
 {
 	int ret;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_reset *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_reset *body = wfx_alloc_hif(wvif->wdev, sizeof(*body), &hif);
 
 	if (!hif)
 		return -ENOMEM;
 	body->reset_stat = reset_stat;
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_RESET, sizeof(*body));
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	/* The chip forgets the configuration of the interface */
+	wfx_hif_mib_cache_flush(wvif->wdev, wvif->id);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -174,8 +571,8 @@ int wfx_hif_read_mib(struct wfx_dev *wdev, int vif_id, u16 mib_id, void *val, si
 	int ret;
 	struct wfx_hif_msg *hif;
 	int buf_len = sizeof(struct wfx_hif_cnf_read_mib) + val_len;
-	struct wfx_hif_req_read_mib *body = wfx_alloc_hif(sizeof(*body), &hif);
-	struct wfx_hif_cnf_read_mib *reply = kmalloc(buf_len, GFP_KERNEL);
+	struct wfx_hif_req_read_mib *body = wfx_alloc_hif(wdev, sizeof(*body), &hif);
+	struct wfx_hif_cnf_read_mib *reply = wfx_hif_buf_alloc(wdev, buf_len);
 
 	if (!body || !reply) {
 		ret = -ENOMEM;
@@ -197,8 +594,8 @@ int wfx_hif_read_mib(struct wfx_dev *wdev, int vif_id, u16 mib_id, void *val, si
 	else
 		memset(val, 0xFF, val_len);
 out:
-	kfree(hif);
-	kfree(reply);
+	wfx_free_hif(wdev, hif);
+	wfx_hif_buf_free(wdev, reply);
 	return ret;
 }
 
@@ -207,16 +604,48 @@ int wfx_hif_write_mib(struct wfx_dev *wdev, int vif_id, u16 mib_id, void *val, s
 	int ret;
 	struct wfx_hif_msg *hif;
 	int buf_len = sizeof(struct wfx_hif_req_write_mib) + val_len;
-	struct wfx_hif_req_write_mib *body = wfx_alloc_hif(buf_len, &hif);
+	struct wfx_hif_req_write_mib *body;
 
-	if (!hif)
+	if (wfx_hif_mib_cache_check(wdev, vif_id, mib_id, val, val_len))
+		return 0;
+	body = wfx_alloc_hif(wdev, buf_len, &hif);
+	if (!hif) {
+		wfx_hif_mib_cache_invalidate(wdev, vif_id, mib_id);
 		return -ENOMEM;
+	}
 	body->mib_id = cpu_to_le16(mib_id);
 	body->length = cpu_to_le16(val_len);
 	memcpy(&body->mib_data, val, val_len);
 	wfx_fill_header(hif, vif_id, HIF_REQ_ID_WRITE_MIB, buf_len);
 	ret = wfx_cmd_send(wdev, hif, NULL, 0, false);
-	kfree(hif);
+	if (ret)
+		wfx_hif_mib_cache_invalidate(wdev, vif_id, mib_id);
+	wfx_free_hif(wdev, hif);
+	return ret;
+}
+
+int wfx_hif_write_mib_async(struct wfx_dev *wdev, int vif_id, u16 mib_id,
+			    void *val, size_t val_len)
+{
+	struct wfx_hif_msg *hif;
+	int buf_len = sizeof(struct wfx_hif_req_write_mib) + val_len;
+	struct wfx_hif_req_write_mib *body;
+	int ret;
+
+	if (wfx_hif_mib_cache_check(wdev, vif_id, mib_id, val, val_len))
+		return 0;
+	body = wfx_alloc_hif(wdev, buf_len, &hif);
+	if (!hif) {
+		wfx_hif_mib_cache_invalidate(wdev, vif_id, mib_id);
+		return -ENOMEM;
+	}
+	body->mib_id = cpu_to_le16(mib_id);
+	body->length = cpu_to_le16(val_len);
+	memcpy(&body->mib_data, val, val_len);
+	wfx_fill_header(hif, vif_id, HIF_REQ_ID_WRITE_MIB, buf_len);
+	ret = wfx_cmd_send_async(wdev, hif);
+	if (ret)
+		wfx_hif_mib_cache_invalidate(wdev, vif_id, mib_id);
 	return ret;
 }
 
@@ -226,7 +655,7 @@ int wfx_hif_scan(struct wfx_vif *wvif, struct cfg80211_scan_request *req,
 	int ret, i;
 	struct wfx_hif_msg *hif;
 	size_t buf_len = sizeof(struct wfx_hif_req_start_scan_alt) + chan_num * sizeof(u8);
-	struct wfx_hif_req_start_scan_alt *body = wfx_alloc_hif(buf_len, &hif);
+	struct wfx_hif_req_start_scan_alt *body = wfx_alloc_hif(wvif->wdev, buf_len, &hif);
 
 	WARN(chan_num > HIF_API_MAX_NB_CHANNELS, "invalid params");
 	WARN(req->n_ssids > HIF_API_MAX_NB_SSIDS, "invalid params");
@@ -260,7 +689,7 @@ int wfx_hif_scan(struct wfx_vif *wvif, struct cfg80211_scan_request *req,
 
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_START_SCAN, buf_len);
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -269,13 +698,13 @@ int wfx_hif_stop_scan(struct wfx_vif *wvif)
 	int ret;
 	struct wfx_hif_msg *hif;
 	/* body associated to HIF_REQ_ID_STOP_SCAN is empty */
-	wfx_alloc_hif(0, &hif);
+	wfx_alloc_hif(wvif->wdev, 0, &hif);
 
 	if (!hif)
 		return -ENOMEM;
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_STOP_SCAN, 0);
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -286,7 +715,7 @@ int wfx_hif_join(struct wfx_vif *wvif, const struct ieee80211_bss_conf *conf,
 						 bss_conf);
 	int ret;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_join *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_join *body = wfx_alloc_hif(wvif->wdev, sizeof(*body), &hif);
 
 	WARN_ON(!conf->beacon_int);
 	WARN_ON(!conf->basic_rates);
@@ -307,7 +736,7 @@ int wfx_hif_join(struct wfx_vif *wvif, const struct ieee80211_bss_conf *conf,
 	}
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_JOIN, sizeof(*body));
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -315,7 +744,7 @@ int wfx_hif_set_bss_params(struct wfx_vif *wvif, int aid, int beacon_lost_count)
 {
 	int ret;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_set_bss_params *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_set_bss_params *body = wfx_alloc_hif(wvif->wdev, sizeof(*body), &hif);
 
 	if (!hif)
 		return -ENOMEM;
@@ -323,7 +752,7 @@ int wfx_hif_set_bss_params(struct wfx_vif *wvif, int aid, int beacon_lost_count)
 	body->beacon_lost_count = beacon_lost_count;
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_SET_BSS_PARAMS, sizeof(*body));
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -332,7 +761,7 @@ int wfx_hif_add_key(struct wfx_dev *wdev, const struct wfx_hif_req_add_key *arg)
 	int ret;
 	struct wfx_hif_msg *hif;
 	/* FIXME: only send necessary bits */
-	struct wfx_hif_req_add_key *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_add_key *body = wfx_alloc_hif(wdev, sizeof(*body), &hif);
 
 	if (!hif)
 		return -ENOMEM;
@@ -344,7 +773,7 @@ int wfx_hif_add_key(struct wfx_dev *wdev, const struct wfx_hif_req_add_key *arg)
 	else
 		wfx_fill_header(hif, -1, HIF_REQ_ID_ADD_KEY, sizeof(*body));
 	ret = wfx_cmd_send(wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wdev, hif);
 	return ret;
 }
 
@@ -352,14 +781,14 @@ int wfx_hif_remove_key(struct wfx_dev *wdev, int idx)
 {
 	int ret;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_remove_key *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_remove_key *body = wfx_alloc_hif(wdev, sizeof(*body), &hif);
 
 	if (!hif)
 		return -ENOMEM;
 	body->entry_index = idx;
 	wfx_fill_header(hif, -1, HIF_REQ_ID_REMOVE_KEY, sizeof(*body));
 	ret = wfx_cmd_send(wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wdev, hif);
 	return ret;
 }
 
@@ -368,7 +797,7 @@ int wfx_hif_set_edca_queue_params(struct wfx_vif *wvif, u16 queue,
 {
 	int ret;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_edca_queue_params *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_edca_queue_params *body = wfx_alloc_hif(wvif->wdev, sizeof(*body), &hif);
 
 	if (!body)
 		return -ENOMEM;
@@ -388,7 +817,7 @@ int wfx_hif_set_edca_queue_params(struct wfx_vif *wvif, u16 queue,
 		body->queue_id = HIF_QUEUE_ID_BESTEFFORT;
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_EDCA_QUEUE_PARAMS, sizeof(*body));
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -396,7 +825,7 @@ int wfx_hif_set_pm(struct wfx_vif *wvif, bool ps, int dynamic_ps_timeout)
 {
 	int ret;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_set_pm_mode *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_set_pm_mode *body = wfx_alloc_hif(wvif->wdev, sizeof(*body), &hif);
 
 	if (!body)
 		return -ENOMEM;
@@ -412,7 +841,7 @@ int wfx_hif_set_pm(struct wfx_vif *wvif, bool ps, int dynamic_ps_timeout)
 	}
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_SET_PM_MODE, sizeof(*body));
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -423,7 +852,7 @@ int wfx_hif_start(struct wfx_vif *wvif, const struct ieee80211_bss_conf *conf,
 						 bss_conf);
 	int ret;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_start *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_start *body = wfx_alloc_hif(wvif->wdev, sizeof(*body), &hif);
 
 	WARN_ON(!conf->beacon_int);
 	if (!hif)
@@ -437,7 +866,7 @@ int wfx_hif_start(struct wfx_vif *wvif, const struct ieee80211_bss_conf *conf,
 	memcpy(body->ssid, vif->cfg.ssid, vif->cfg.ssid_len);
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_START, sizeof(*body));
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -445,14 +874,14 @@ int wfx_hif_beacon_transmit(struct wfx_vif *wvif, bool enable)
 {
 	int ret;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_beacon_transmit *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_beacon_transmit *body = wfx_alloc_hif(wvif->wdev, sizeof(*body), &hif);
 
 	if (!hif)
 		return -ENOMEM;
 	body->enable_beaconing = enable ? 1 : 0;
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_BEACON_TRANSMIT, sizeof(*body));
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -460,7 +889,7 @@ int wfx_hif_map_link(struct wfx_vif *wvif, bool unmap, u8 *mac_addr, int sta_id,
 {
 	int ret;
 	struct wfx_hif_msg *hif;
-	struct wfx_hif_req_map_link *body = wfx_alloc_hif(sizeof(*body), &hif);
+	struct wfx_hif_req_map_link *body = wfx_alloc_hif(wvif->wdev, sizeof(*body), &hif);
 
 	if (!hif)
 		return -ENOMEM;
@@ -471,7 +900,7 @@ int wfx_hif_map_link(struct wfx_vif *wvif, bool unmap, u8 *mac_addr, int sta_id,
 	body->peer_sta_id = sta_id;
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_MAP_LINK, sizeof(*body));
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
 
@@ -480,7 +909,7 @@ int wfx_hif_update_ie_beacon(struct wfx_vif *wvif, const u8 *ies, size_t ies_len
 	int ret;
 	struct wfx_hif_msg *hif;
 	int buf_len = sizeof(struct wfx_hif_req_update_ie) + ies_len;
-	struct wfx_hif_req_update_ie *body = wfx_alloc_hif(buf_len, &hif);
+	struct wfx_hif_req_update_ie *body = wfx_alloc_hif(wvif->wdev, buf_len, &hif);
 
 	if (!hif)
 		return -ENOMEM;
@@ -489,6 +918,6 @@ int wfx_hif_update_ie_beacon(struct wfx_vif *wvif, const u8 *ies, size_t ies_len
 	memcpy(body->ie, ies, ies_len);
 	wfx_fill_header(hif, wvif->id, HIF_REQ_ID_UPDATE_IE, buf_len);
 	ret = wfx_cmd_send(wvif->wdev, hif, NULL, 0, false);
-	kfree(hif);
+	wfx_free_hif(wvif->wdev, hif);
 	return ret;
 }
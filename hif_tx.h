@@ -11,8 +11,12 @@
 #define WFX_HIF_TX_H
 
 #include <linux/types.h>
+#include <linux/list.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 #include <linux/completion.h>
+#include <linux/ktime.h>
 
 struct ieee80211_channel;
 struct ieee80211_bss_conf;
@@ -22,22 +26,104 @@ struct wfx_hif_req_add_key;
 struct wfx_dev;
 struct wfx_vif;
 
-struct wfx_hif_cmd {
-	struct mutex       lock;
-	struct completion  ready;
-	struct completion  done;
+/* Maximum number of requests sent to the chip and waiting for a confirmation */
+#define WFX_HIF_CMD_IN_FLIGHT_MAX 4
+/* Number of preallocated buffers for the requests and their replies */
+#define WFX_HIF_ARENA_SLOTS 24
+
+struct wfx_hif_cmd_req {
+	struct list_head   link;
 	struct wfx_hif_msg *buf_send;
 	void               *buf_recv;
 	size_t             len_recv;
+	bool               no_reply;
 	int                ret;
+	ktime_t            queued;
+	size_t             len_cnf;
+	/* Called once the confirmation is received (usually from the bh). Must not sleep. */
+	void               (*complete)(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req);
+	struct completion  done;
+};
+
+/* Latencies are sorted by power of 2 of microseconds. The last bucket also contains the larger
+ * values.
+ */
+#define WFX_HIF_STATS_BUCKETS 16
+
+struct wfx_hif_cmd_stats {
+	unsigned int       count;
+	u64                bytes_req;
+	u64                bytes_cnf;
+	unsigned int       latency[WFX_HIF_STATS_BUCKETS];
+};
+
+/* MIB IDs range from 0x2000 to 0x205F */
+#define WFX_MIB_ID_NUM 0x60
+
+/* Number of entries of wfx_hif_mib_cache_ids[] */
+#define WFX_MIB_CACHE_SIZE 17
+/* Larger values (e.g. the templates) are not cached */
+#define WFX_MIB_CACHE_VAL_MAX 64
+
+struct wfx_hif_mib_cache_entry {
+	u8                 data[WFX_MIB_CACHE_VAL_MAX];
+	size_t             len; /* 0 if the value is unknown */
+	unsigned int       skipped;
+};
+
+extern const u16 wfx_hif_mib_cache_ids[WFX_MIB_CACHE_SIZE];
+
+/* Last value written to each cached MIB of interfaces 0, 1 and 2 (the device) */
+struct wfx_hif_mib_cache {
+	spinlock_t         lock;
+	struct wfx_hif_mib_cache_entry entries[3][WFX_MIB_CACHE_SIZE];
+	unsigned int       written;
+	unsigned int       skipped;
+};
+
+struct wfx_hif_cmd {
+	struct mutex       lock; /* held by wfx_tx_flush() to prevent new requests */
+	spinlock_t         queue_lock;
+	struct list_head   queued; /* not yet sent to the chip */
+	struct list_head   sent; /* waiting for a confirmation */
+	struct wfx_hif_cmd_req *in_transit; /* being sent by the bh */
+	int                in_transit_abort; /* error to report once in_transit is sent */
+	int                num_sent;
+	wait_queue_head_t  idle;
+
+	spinlock_t         arena_lock;
+	u8                 *arena;
+	size_t             arena_slot_size;
+	unsigned long      arena_free; /* bitmap of the free slots */
+	unsigned int       arena_fallbacks;
+	/* Requests of the asynchronous messages, indexed by the arena slot of the message */
+	struct wfx_hif_cmd_req async_reqs[WFX_HIF_ARENA_SLOTS];
+
+	spinlock_t         stats_lock;
+	struct wfx_hif_cmd_stats stats[0x40]; /* indexed by request ID */
+	struct wfx_hif_cmd_stats stats_mib[WFX_MIB_ID_NUM]; /* indexed by MIB ID - 0x2000 */
 };
 
 void wfx_init_hif_cmd(struct wfx_hif_cmd *wfx_hif_cmd);
+int wfx_hif_arena_init(struct wfx_dev *wdev);
+void *wfx_hif_buf_alloc(struct wfx_dev *wdev, size_t len);
+void wfx_hif_buf_free(struct wfx_dev *wdev, void *buf);
+void wfx_hif_mib_cache_init(struct wfx_hif_mib_cache *cache);
+void wfx_hif_mib_cache_flush(struct wfx_dev *wdev, int vif_id);
+void wfx_cmd_queue(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req);
 int wfx_cmd_send(struct wfx_dev *wdev, struct wfx_hif_msg *request,
 		 void *reply, size_t reply_len, bool async);
+int wfx_cmd_send_async(struct wfx_dev *wdev, struct wfx_hif_msg *request);
+int wfx_cmd_wait_idle(struct wfx_dev *wdev);
+struct wfx_hif_cmd_req *wfx_cmd_get_next(struct wfx_dev *wdev);
+void wfx_cmd_sent(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req);
+struct wfx_hif_cmd_req *wfx_cmd_get_sent(struct wfx_dev *wdev, int cmd);
+void wfx_cmd_done(struct wfx_dev *wdev, struct wfx_hif_cmd_req *req);
 
 int wfx_hif_read_mib(struct wfx_dev *wdev, int vif_id, u16 mib_id, void *buf, size_t buf_size);
 int wfx_hif_write_mib(struct wfx_dev *wdev, int vif_id, u16 mib_id, void *buf, size_t buf_size);
+int wfx_hif_write_mib_async(struct wfx_dev *wdev, int vif_id, u16 mib_id,
+			    void *buf, size_t buf_size);
 int wfx_hif_start(struct wfx_vif *wvif, const struct ieee80211_bss_conf *conf,
 		  const struct ieee80211_channel *channel);
 int wfx_hif_reset(struct wfx_vif *wvif, bool reset_stat);
@@ -20,8 +20,8 @@ int wfx_hif_set_output_power(struct wfx_vif *wvif, int val)
 		.power_level = cpu_to_le32(val * 10),
 	};
 
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_CURRENT_TX_POWER_LEVEL,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_CURRENT_TX_POWER_LEVEL,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_set_beacon_wakeup_period(struct wfx_vif *wvif,
@@ -35,8 +35,8 @@ int wfx_hif_set_beacon_wakeup_period(struct wfx_vif *wvif,
 
 	if (dtim_interval > 0xFF || listen_interval > 0xFFFF)
 		return -EINVAL;
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_BEACON_WAKEUP_PERIOD,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_BEACON_WAKEUP_PERIOD,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_set_rcpi_rssi_threshold(struct wfx_vif *wvif, int rssi_thold, int rssi_hyst)
@@ -56,8 +56,8 @@ int wfx_hif_set_rcpi_rssi_threshold(struct wfx_vif *wvif, int rssi_thold, int rs
 		arg.lower_threshold = (arg.lower_threshold + 110) * 2;
 	}
 
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_RCPI_RSSI_THRESHOLD,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_RCPI_RSSI_THRESHOLD,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_get_counters_table(struct wfx_dev *wdev, int vif_id,
@@ -92,7 +92,8 @@ int wfx_hif_set_rx_filter(struct wfx_vif *wvif, bool filter_bssid, bool filter_p
 		arg.bssid_filter = 1;
 	if (!filter_prbreq)
 		arg.fwd_probe_req = 1;
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_RX_FILTER, &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_RX_FILTER,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_set_beacon_filter_table(struct wfx_vif *wvif, int tbl_len,
@@ -102,14 +103,14 @@ int wfx_hif_set_beacon_filter_table(struct wfx_vif *wvif, int tbl_len,
 	struct wfx_hif_mib_bcn_filter_table *arg;
 	int buf_len = struct_size(arg, ie_table, tbl_len);
 
-	arg = kzalloc(buf_len, GFP_KERNEL);
+	arg = wfx_hif_buf_alloc(wvif->wdev, buf_len);
 	if (!arg)
 		return -ENOMEM;
 	arg->num_of_info_elmts = cpu_to_le32(tbl_len);
 	memcpy(arg->ie_table, tbl, flex_array_size(arg, ie_table, tbl_len));
-	ret = wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_BEACON_FILTER_TABLE,
-				arg, buf_len);
-	kfree(arg);
+	ret = wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_BEACON_FILTER_TABLE,
+				      arg, buf_len);
+	wfx_hif_buf_free(wvif->wdev, arg);
 	return ret;
 }
 
@@ -119,8 +120,8 @@ int wfx_hif_beacon_filter_control(struct wfx_vif *wvif, int enable, int beacon_c
 		.enable = cpu_to_le32(enable),
 		.bcn_count = cpu_to_le32(beacon_count),
 	};
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_BEACON_FILTER_ENABLE,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_BEACON_FILTER_ENABLE,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_set_operational_mode(struct wfx_dev *wdev, enum wfx_hif_op_power_mode mode)
@@ -172,8 +173,8 @@ int wfx_hif_set_block_ack_policy(struct wfx_vif *wvif, u8 tx_tid_policy, u8 rx_t
 		.block_ack_rx_tid_policy = rx_tid_policy,
 	};
 
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_BLOCK_ACK_POLICY,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_BLOCK_ACK_POLICY,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_set_association_mode(struct wfx_vif *wvif, int ampdu_density,
@@ -188,8 +189,8 @@ int wfx_hif_set_association_mode(struct wfx_vif *wvif, int ampdu_density,
 		.mpdu_start_spacing = ampdu_density,
 	};
 
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_SET_ASSOCIATION_MODE,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_SET_ASSOCIATION_MODE,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_set_tx_rate_retry_policy(struct wfx_vif *wvif, int policy_index, u8 *rates)
@@ -198,7 +199,7 @@ int wfx_hif_set_tx_rate_retry_policy(struct wfx_vif *wvif, int policy_index, u8
 	size_t size = struct_size(arg, tx_rate_retry_policy, 1);
 	int ret;
 
-	arg = kzalloc(size, GFP_KERNEL);
+	arg = wfx_hif_buf_alloc(wvif->wdev, size);
 	if (!arg)
 		return -ENOMEM;
 	arg->num_tx_rate_policies = 1;
@@ -212,7 +213,7 @@ int wfx_hif_set_tx_rate_retry_policy(struct wfx_vif *wvif, int policy_index, u8
 	       sizeof(arg->tx_rate_retry_policy[0].rates));
 	ret = wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_SET_TX_RATE_RETRY_POLICY,
 				arg, size);
-	kfree(arg);
+	wfx_hif_buf_free(wvif->wdev, arg);
 	return ret;
 }
 
@@ -222,8 +223,8 @@ int wfx_hif_keep_alive_period(struct wfx_vif *wvif, int period)
 		.keep_alive_period = cpu_to_le16(period),
 	};
 
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_KEEP_ALIVE_PERIOD,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_KEEP_ALIVE_PERIOD,
+				       &arg, sizeof(arg));
 };
 
 int wfx_hif_set_arp_ipv4_filter(struct wfx_vif *wvif, int idx, __be32 *addr)
@@ -238,8 +239,8 @@ int wfx_hif_set_arp_ipv4_filter(struct wfx_vif *wvif, int idx, __be32 *addr)
 		memcpy(arg.ipv4_address, addr, sizeof(arg.ipv4_address));
 		arg.arp_enable = HIF_ARP_NS_FILTERING_ENABLE;
 	}
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_ARP_IP_ADDRESSES_TABLE,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_ARP_IP_ADDRESSES_TABLE,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_use_multi_tx_conf(struct wfx_dev *wdev, bool enable)
@@ -263,8 +264,8 @@ int wfx_hif_set_uapsd_info(struct wfx_vif *wvif, unsigned long val)
 		arg.trig_be = 1;
 	if (val & BIT(IEEE80211_AC_BK))
 		arg.trig_bckgrnd = 1;
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_SET_UAPSD_INFORMATION,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_SET_UAPSD_INFORMATION,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_erp_use_protection(struct wfx_vif *wvif, bool enable)
@@ -273,8 +274,8 @@ int wfx_hif_erp_use_protection(struct wfx_vif *wvif, bool enable)
 		.use_cts_to_self = enable,
 	};
 
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_NON_ERP_PROTECTION,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_NON_ERP_PROTECTION,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_slot_time(struct wfx_vif *wvif, int val)
@@ -283,7 +284,8 @@ int wfx_hif_slot_time(struct wfx_vif *wvif, int val)
 		.slot_time = cpu_to_le32(val),
 	};
 
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_SLOT_TIME, &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_SLOT_TIME,
+				       &arg, sizeof(arg));
 }
 
 int wfx_hif_wep_default_key_id(struct wfx_vif *wvif, int val)
@@ -302,6 +304,28 @@ int wfx_hif_rts_threshold(struct wfx_vif *wvif, int val)
 		.threshold = cpu_to_le32(val >= 0 ? val : 0xFFFF),
 	};
 
-	return wfx_hif_write_mib(wvif->wdev, wvif->id, HIF_MIB_ID_DOT11_RTS_THRESHOLD,
-				 &arg, sizeof(arg));
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_DOT11_RTS_THRESHOLD,
+				       &arg, sizeof(arg));
+}
+
+int wfx_hif_max_tx_msdu_lifetime(struct wfx_vif *wvif, int val)
+{
+	struct wfx_hif_mib_dot11_max_transmit_msdu_lifetime arg = {
+		.max_life_time = cpu_to_le32(val),
+	};
+
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id,
+				       HIF_MIB_ID_DOT11_MAX_TRANSMIT_MSDU_LIFETIME,
+				       &arg, sizeof(arg));
+}
+
+int wfx_hif_set_internal_tx_rate(struct wfx_vif *wvif, int rate, int non_erp_rate)
+{
+	struct wfx_hif_mib_override_int_rate arg = {
+		.internal_tx_rate = rate,
+		.non_erp_internal_tx_rate = non_erp_rate,
+	};
+
+	return wfx_hif_write_mib_async(wvif->wdev, wvif->id, HIF_MIB_ID_OVERRIDE_INTERNAL_TX_RATE,
+				       &arg, sizeof(arg));
 }
@@ -44,5 +44,7 @@ int wfx_hif_erp_use_protection(struct wfx_vif *wvif, bool enable);
 int wfx_hif_slot_time(struct wfx_vif *wvif, int val);
 int wfx_hif_wep_default_key_id(struct wfx_vif *wvif, int val);
 int wfx_hif_rts_threshold(struct wfx_vif *wvif, int val);
+int wfx_hif_max_tx_msdu_lifetime(struct wfx_vif *wvif, int val);
+int wfx_hif_set_internal_tx_rate(struct wfx_vif *wvif, int rate, int non_erp_rate);
 
 #endif
@@ -7,6 +7,7 @@
  */
 #include <linux/kernel.h>
 #include <linux/delay.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/align.h>
 
@@ -17,6 +18,58 @@
 
 #define WFX_HIF_BUFFER_SIZE 0x2000
 
+/* Maximum duration of a bus session before the other users of the bus get a chance to run */
+#define WFX_BUS_SESSION_MAX_US 2000
+
+/* Inside a session, the bus is already locked */
+static void wfx_bus_lock(struct wfx_dev *wdev)
+{
+	if (READ_ONCE(wdev->bus_session_owner) == current) {
+		wdev->bus_session_xfers++;
+		return;
+	}
+	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+}
+
+static void wfx_bus_unlock(struct wfx_dev *wdev)
+{
+	if (READ_ONCE(wdev->bus_session_owner) == current)
+		return;
+	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+}
+
+/* Keep the bus locked across several transfers. With SDIO, it avoids to claim and release the host
+ * for every register access. Sessions cannot be nested.
+ */
+void wfx_bus_session_start(struct wfx_dev *wdev)
+{
+	WARN_ON(wdev->bus_session_owner);
+	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wdev->bus_session_start = ktime_get();
+	WRITE_ONCE(wdev->bus_session_owner, current);
+	wdev->bus_sessions++;
+}
+
+void wfx_bus_session_end(struct wfx_dev *wdev)
+{
+	WARN_ON(wdev->bus_session_owner != current);
+	WRITE_ONCE(wdev->bus_session_owner, NULL);
+	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+}
+
+/* To call regularly during a session. If the session is too long, release the bus for a while so
+ * the other users of the bus (e.g. the other functions of the SDIO card) are not starved.
+ */
+void wfx_bus_session_yield(struct wfx_dev *wdev)
+{
+	if (ktime_us_delta(ktime_get(), wdev->bus_session_start) < WFX_BUS_SESSION_MAX_US)
+		return;
+	wfx_bus_session_end(wdev);
+	cond_resched();
+	wfx_bus_session_start(wdev);
+	wdev->bus_session_yields++;
+}
+
 static int wfx_read32(struct wfx_dev *wdev, int reg, u32 *val)
 {
 	int ret;
@@ -53,10 +106,10 @@ static int wfx_read32_locked(struct wfx_dev *wdev, int reg, u32 *val)
 {
 	int ret;
 
-	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wfx_bus_lock(wdev);
 	ret = wfx_read32(wdev, reg, val);
 	_trace_io_read32(reg, *val);
-	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
 	return ret;
 }
 
@@ -64,10 +117,10 @@ static int wfx_write32_locked(struct wfx_dev *wdev, int reg, u32 val)
 {
 	int ret;
 
-	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wfx_bus_lock(wdev);
 	ret = wfx_write32(wdev, reg, val);
 	_trace_io_write32(reg, val);
-	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
 	return ret;
 }
 
@@ -78,7 +131,7 @@ static int wfx_write32_bits_locked(struct wfx_dev *wdev, int reg, u32 mask, u32
 
 	WARN_ON(~mask & val);
 	val &= mask;
-	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wfx_bus_lock(wdev);
 	ret = wfx_read32(wdev, reg, &val_r);
 	_trace_io_read32(reg, val_r);
 	if (ret < 0)
@@ -89,7 +142,7 @@ static int wfx_write32_bits_locked(struct wfx_dev *wdev, int reg, u32 mask, u32
 		_trace_io_write32(reg, val_w);
 	}
 err:
-	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
 	return ret;
 }
 
@@ -162,10 +215,10 @@ static int wfx_indirect_read_locked(struct wfx_dev *wdev, int reg, u32 addr,
 {
 	int ret;
 
-	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wfx_bus_lock(wdev);
 	ret = wfx_indirect_read(wdev, reg, addr, buf, len);
 	_trace_io_ind_read(reg, addr, buf, len);
-	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
 	return ret;
 }
 
@@ -174,10 +227,10 @@ static int wfx_indirect_write_locked(struct wfx_dev *wdev, int reg, u32 addr,
 {
 	int ret;
 
-	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wfx_bus_lock(wdev);
 	ret = wfx_indirect_write(wdev, reg, addr, buf, len);
 	_trace_io_ind_write(reg, addr, buf, len);
-	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
 	return ret;
 }
 
@@ -188,11 +241,11 @@ static int wfx_indirect_read32_locked(struct wfx_dev *wdev, int reg, u32 addr, u
 
 	if (!tmp)
 		return -ENOMEM;
-	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wfx_bus_lock(wdev);
 	ret = wfx_indirect_read(wdev, reg, addr, tmp, sizeof(u32));
 	*val = le32_to_cpu(*tmp);
 	_trace_io_ind_read32(reg, addr, *val);
-	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
 	kfree(tmp);
 	return ret;
 }
@@ -205,10 +258,10 @@ static int wfx_indirect_write32_locked(struct wfx_dev *wdev, int reg, u32 addr,
 	if (!tmp)
 		return -ENOMEM;
 	*tmp = cpu_to_le32(val);
-	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wfx_bus_lock(wdev);
 	ret = wfx_indirect_write(wdev, reg, addr, tmp, sizeof(u32));
 	_trace_io_ind_write32(reg, addr, val);
-	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
 	kfree(tmp);
 	return ret;
 }
@@ -218,10 +271,10 @@ int wfx_data_read(struct wfx_dev *wdev, void *buf, size_t len)
 	int ret;
 
 	WARN(!IS_ALIGNED((uintptr_t)buf, 4), "unaligned buffer");
-	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wfx_bus_lock(wdev);
 	ret = wdev->hwbus_ops->copy_from_io(wdev->hwbus_priv, WFX_REG_IN_OUT_QUEUE, buf, len);
 	_trace_io_read(WFX_REG_IN_OUT_QUEUE, buf, len);
-	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
 	if (ret)
 		dev_err(wdev->dev, "%s: bus communication error: %d\n", __func__, ret);
 	return ret;
@@ -232,10 +285,27 @@ int wfx_data_write(struct wfx_dev *wdev, const void *buf, size_t len)
 	int ret;
 
 	WARN(!IS_ALIGNED((uintptr_t)buf, 4), "unaligned buffer");
-	wdev->hwbus_ops->lock(wdev->hwbus_priv);
+	wfx_bus_lock(wdev);
 	ret = wdev->hwbus_ops->copy_to_io(wdev->hwbus_priv, WFX_REG_IN_OUT_QUEUE, buf, len);
 	_trace_io_write(WFX_REG_IN_OUT_QUEUE, buf, len);
-	wdev->hwbus_ops->unlock(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
+	if (ret)
+		dev_err(wdev->dev, "%s: bus communication error: %d\n", __func__, ret);
+	return ret;
+}
+
+/* Some buses return from wfx_data_write() before the end of the transfer. Then, the buffers passed
+ * to wfx_data_write() cannot be released before this function is called.
+ */
+int wfx_data_flush(struct wfx_dev *wdev)
+{
+	int ret;
+
+	if (!wdev->hwbus_ops->flush)
+		return 0;
+	wfx_bus_lock(wdev);
+	ret = wdev->hwbus_ops->flush(wdev->hwbus_priv);
+	wfx_bus_unlock(wdev);
 	if (ret)
 		dev_err(wdev->dev, "%s: bus communication error: %d\n", __func__, ret);
 	return ret;
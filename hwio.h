@@ -12,11 +12,16 @@
 
 struct wfx_dev;
 
+void wfx_bus_session_start(struct wfx_dev *wdev);
+void wfx_bus_session_yield(struct wfx_dev *wdev);
+void wfx_bus_session_end(struct wfx_dev *wdev);
+
 /* Caution: in the functions below, 'buf' will used with a DMA. So, it must be kmalloc'd (do not use
  * stack allocated buffers). In doubt, enable CONFIG_DEBUG_SG to detect badly located buffer.
  */
 int wfx_data_read(struct wfx_dev *wdev, void *buf, size_t buf_len);
 int wfx_data_write(struct wfx_dev *wdev, const void *buf, size_t buf_len);
+int wfx_data_flush(struct wfx_dev *wdev);
 
 int wfx_sram_buf_read(struct wfx_dev *wdev, u32 addr, void *buf, size_t len);
 int wfx_sram_buf_write(struct wfx_dev *wdev, u32 addr, const void *buf, size_t len);
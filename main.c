@@ -30,6 +30,7 @@
 #include "scan.h"
 #include "debug.h"
 #include "data_tx.h"
+#include "data_rx.h"
 #include "hif_tx_mib.h"
 #include "hif_api_cmd.h"
 
@@ -40,6 +41,42 @@ MODULE_DESCRIPTION("Silicon Labs 802.11 Wireless LAN driver for WF200");
 MODULE_AUTHOR("Jérôme Pouiller <jerome.pouiller@silabs.com>");
 MODULE_LICENSE("GPL");
 
+static bool fw_rate_control;
+module_param(fw_rate_control, bool, 0444);
+MODULE_PARM_DESC(fw_rate_control, "Let the firmware choose the Tx rates (default: N)");
+
+static bool bh_in_irq;
+module_param(bh_in_irq, bool, 0444);
+MODULE_PARM_DESC(bh_in_irq, "Run the bh directly in the threaded IRQ handler (default: N)");
+
+static bool bh_thread;
+module_param(bh_thread, bool, 0444);
+MODULE_PARM_DESC(bh_thread, "Run the bh from a dedicated thread (default: N)");
+
+static char *bh_thread_policy = "normal";
+module_param(bh_thread_policy, charp, 0444);
+MODULE_PARM_DESC(bh_thread_policy, "normal, fifo_low or fifo (default: normal)");
+
+static int bh_thread_nice;
+module_param(bh_thread_nice, int, 0444);
+MODULE_PARM_DESC(bh_thread_nice, "Nice value of the bh thread with the normal policy (default: 0)");
+
+static char *bh_thread_cpus;
+module_param(bh_thread_cpus, charp, 0444);
+MODULE_PARM_DESC(bh_thread_cpus, "List of the CPUs allowed to run the bh thread (default: all)");
+
+static unsigned int bh_poll_max_us;
+module_param(bh_poll_max_us, uint, 0444);
+MODULE_PARM_DESC(bh_poll_max_us, "Busy-poll the chip for up to N us after the bh (default: 0)");
+
+static unsigned int keep_awake_ms;
+module_param(keep_awake_ms, uint, 0444);
+MODULE_PARM_DESC(keep_awake_ms, "Keep the chip awake N ms after the last exchange (default: 0)");
+
+static bool calibrate_bus;
+module_param(calibrate_bus, bool, 0444);
+MODULE_PARM_DESC(calibrate_bus, "Measure the bus block sizes during probe (default: N)");
+
 #define RATETAB_ENT(_rate, _rateid, _flags) { \
 	.bitrate  = (_rate),   \
 	.hw_value = (_rateid), \
@@ -128,6 +165,7 @@ static const struct ieee80211_ops wfx_ops = {
 	.remove_interface        = wfx_remove_interface,
 	.config                  = wfx_config,
 	.tx                      = wfx_tx,
+	.wake_tx_queue           = wfx_wake_tx_queue,
 	.join_ibss               = wfx_join_ibss,
 	.leave_ibss              = wfx_leave_ibss,
 	.conf_tx                 = wfx_conf_tx,
@@ -269,6 +307,8 @@ struct wfx_dev *wfx_init_common(struct device *dev, const struct wfx_platform_da
 	ieee80211_hw_set(hw, SIGNAL_DBM);
 	ieee80211_hw_set(hw, SUPPORTS_PS);
 	ieee80211_hw_set(hw, MFP_CAPABLE);
+	if (fw_rate_control)
+		ieee80211_hw_set(hw, HAS_RATE_CONTROL);
 
 	hw->vif_data_size = sizeof(struct wfx_vif);
 	hw->sta_data_size = sizeof(struct wfx_sta_priv);
@@ -285,6 +325,7 @@ struct wfx_dev *wfx_init_common(struct device *dev, const struct wfx_platform_da
 					NL80211_PROBE_RESP_OFFLOAD_SUPPORT_P2P |
 					NL80211_PROBE_RESP_OFFLOAD_SUPPORT_80211U;
 	hw->wiphy->features |= NL80211_FEATURE_AP_SCAN;
+	wiphy_ext_feature_set(hw->wiphy, NL80211_EXT_FEATURE_AIRTIME_FAIRNESS);
 	hw->wiphy->flags |= WIPHY_FLAG_AP_PROBE_RESP_OFFLOAD;
 	hw->wiphy->flags |= WIPHY_FLAG_AP_UAPSD;
 	hw->wiphy->max_ap_assoc_sta = HIF_LINK_ID_MAX;
@@ -304,6 +345,15 @@ struct wfx_dev *wfx_init_common(struct device *dev, const struct wfx_platform_da
 	wdev->dev = dev;
 	wdev->hwbus_ops = hwbus_ops;
 	wdev->hwbus_priv = hwbus_priv;
+	wdev->fw_rate_control = fw_rate_control;
+	wdev->bh_in_irq = bh_in_irq;
+	wdev->bh_thread = bh_thread;
+	wdev->bh_thread_policy = bh_thread_policy;
+	wdev->bh_thread_nice = bh_thread_nice;
+	wdev->bh_thread_cpus = bh_thread_cpus;
+	wdev->bh_poll_max_us = bh_poll_max_us;
+	wdev->keep_awake_ms = keep_awake_ms;
+	wdev->calibrate_bus = calibrate_bus;
 	memcpy(&wdev->pdata, pdata, sizeof(*pdata));
 	of_property_read_string(dev->of_node, "silabs,antenna-config-file", &wdev->pdata.file_pds);
 	wdev->pdata.gpio_wakeup = devm_gpiod_get_optional(dev, "wakeup", GPIOD_OUT_LOW);
@@ -318,9 +368,14 @@ struct wfx_dev *wfx_init_common(struct device *dev, const struct wfx_platform_da
 	mutex_init(&wdev->tx_power_loop_info_lock);
 	init_completion(&wdev->firmware_ready);
 	INIT_DELAYED_WORK(&wdev->cooling_timeout_work, wfx_cooling_timeout_work);
+	wdev->tx_lifetime[IEEE80211_AC_VO] = 100;
+	wdev->tx_lifetime[IEEE80211_AC_VI] = 200;
+	spin_lock_init(&wdev->tx_sched_lock);
+	spin_lock_init(&wdev->tx_flow_lock);
 	skb_queue_head_init(&wdev->tx_pending);
 	init_waitqueue_head(&wdev->tx_dequeue);
 	wfx_init_hif_cmd(&wdev->hif_cmd);
+	wfx_hif_mib_cache_init(&wdev->mib_cache);
 
 	if (devm_add_action_or_reset(dev, wfx_free_common, wdev))
 		return NULL;
@@ -349,6 +404,7 @@ int wfx_probe(struct wfx_dev *wdev)
 	if (!wdev->bh_wq)
 		return -ENOMEM;
 
+	wfx_rx_napi_init(wdev);
 	wfx_bh_register(wdev);
 
 	err = wfx_init_device(wdev);
@@ -402,6 +458,14 @@ int wfx_probe(struct wfx_dev *wdev)
 			IEEE80211_CHAN_DISABLED;
 	}
 
+	err = wfx_pending_init(wdev);
+	if (err)
+		goto bh_unregister;
+
+	err = wfx_hif_arena_init(wdev);
+	if (err)
+		goto bh_unregister;
+
 	dev_dbg(wdev->dev, "sending configuration file %s\n", wdev->pdata.file_pds);
 	err = wfx_send_pdata_pds(wdev);
 	if (err < 0 && err != -ENOENT)
@@ -462,6 +526,7 @@ irq_unsubscribe:
 	wdev->hwbus_ops->irq_unsubscribe(wdev->hwbus_priv);
 bh_unregister:
 	wfx_bh_unregister(wdev);
+	wfx_rx_napi_deinit(wdev);
 	destroy_workqueue(wdev->bh_wq);
 	return err;
 }
@@ -472,6 +537,7 @@ void wfx_release(struct wfx_dev *wdev)
 	wfx_hif_shutdown(wdev);
 	wdev->hwbus_ops->irq_unsubscribe(wdev->hwbus_priv);
 	wfx_bh_unregister(wdev);
+	wfx_rx_napi_deinit(wdev);
 	destroy_workqueue(wdev->bh_wq);
 }
 
@@ -483,12 +549,16 @@ static int __init wfx_core_init(void)
 		ret = spi_register_driver(&wfx_spi_driver);
 	if (IS_ENABLED(CONFIG_MMC) && !ret)
 		ret = sdio_register_driver(&wfx_sdio_driver);
+	if (IS_ENABLED(CONFIG_WFX_EMUL) && !ret)
+		ret = wfx_emul_register();
 	return ret;
 }
 module_init(wfx_core_init);
 
 static void __exit wfx_core_exit(void)
 {
+	if (IS_ENABLED(CONFIG_WFX_EMUL))
+		wfx_emul_unregister();
 	if (IS_ENABLED(CONFIG_MMC))
 		sdio_unregister_driver(&wfx_sdio_driver);
 	if (IS_ENABLED(CONFIG_SPI))
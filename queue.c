@@ -6,6 +6,7 @@
  * Copyright (c) 2010, ST-Ericsson
  */
 #include <linux/sched.h>
+#include <linux/log2.h>
 #include <net/mac80211.h>
 
 #include "queue.h"
@@ -63,15 +64,109 @@ void wfx_tx_queues_init(struct wfx_vif *wvif)
 	 * ensure that it roughtly respect the priorities to avoid any shortage.
 	 */
 	const int priorities[IEEE80211_NUM_ACS] = { 1, 2, 64, 128 };
+	/* Keep the latency of the high priority queues low. The frames are pulled from the mac80211
+	 * TXQs up to the high watermark, so it must not exceed WFX_TXQ_DEPTH.
+	 */
+	const int high_watermarks[IEEE80211_NUM_ACS] = {
+		WFX_TXQ_DEPTH / 4, WFX_TXQ_DEPTH / 2, WFX_TXQ_DEPTH, WFX_TXQ_DEPTH
+	};
+	const int delay_targets[IEEE80211_NUM_ACS] = { 2000, 4000, 10000, 20000 };
+	int num_bufs = le16_to_cpu(wvif->wdev->hw_caps.num_inp_ch_bufs);
 	int i;
 
 	for (i = 0; i < IEEE80211_NUM_ACS; ++i) {
 		skb_queue_head_init(&wvif->tx_queue[i].normal);
 		skb_queue_head_init(&wvif->tx_queue[i].cab);
 		wvif->tx_queue[i].priority = priorities[i];
+		wvif->tx_queue[i].sched_idx = -1;
+		wvif->tx_queue[i].high_watermark = high_watermarks[i];
+		wvif->tx_queue[i].low_watermark = high_watermarks[i] / 2;
+		wvif->tx_queue[i].delay_target = delay_targets[i];
+		wvif->tx_queue[i].pending_limit = num_bufs;
+		wvif->tx_queue[i].pending_limit_max = num_bufs;
+		wvif->tx_queue[i].pending_limit_credit = 0;
+		atomic_set(&wvif->tx_queue[i].expired_drv, 0);
+		atomic_set(&wvif->tx_queue[i].expired_fw, 0);
+		atomic_set(&wvif->tx_queue[i].tx_more, 0);
+		atomic_set(&wvif->tx_queue[i].cnf_aggr, 0);
+		atomic_set(&wvif->tx_queue[i].cnf_txop_limit, 0);
+	}
+}
+
+/* Adapt the number of frames of a queue that can be pushed to the firmware. The limit is decreased
+ * each time a frame waited more than delay_target in the firmware queue and is increased by one
+ * frame each time a full limit of frames has been confirmed under the target. It is only raised if
+ * the queue actually reaches its limit.
+ */
+void wfx_tx_queue_update_limit(struct wfx_queue *queue, unsigned int tx_queue_delay)
+{
+	if (tx_queue_delay > queue->delay_target) {
+		queue->pending_limit_credit = 0;
+		if (queue->pending_limit > WFX_PENDING_LIMIT_MIN)
+			queue->pending_limit--;
+	} else if (atomic_read(&queue->pending_frames) + 1 >= queue->pending_limit) {
+		if (++queue->pending_limit_credit >= queue->pending_limit) {
+			queue->pending_limit_credit = 0;
+			if (queue->pending_limit < queue->pending_limit_max)
+				queue->pending_limit++;
+		}
 	}
 }
 
+static int wfx_tx_queue_len(struct wfx_queue *queue)
+{
+	return skb_queue_len_lockless(&queue->normal) + skb_queue_len_lockless(&queue->cab);
+}
+
+static bool wfx_tx_policy_cache_full(struct wfx_dev *wdev)
+{
+	struct wfx_vif *wvif = NULL;
+
+	while ((wvif = wvif_iterate(wdev, wvif)) != NULL)
+		if (list_empty_careful(&wvif->tx_policy_cache.free))
+			return true;
+	return false;
+}
+
+/* Stop the mac80211 queue of an AC as soon as the queue of one vif reaches its high watermark. Wake
+ * it once the queues of all the vifs are back under their low watermark. Since the queues are
+ * also stopped when the retry policy cache is full, do not wake them in this case.
+ */
+void wfx_tx_queue_update_flow(struct wfx_vif *wvif, int ac)
+{
+	struct wfx_queue *queue = &wvif->tx_queue[ac];
+	struct wfx_dev *wdev = wvif->wdev;
+	unsigned long *stopped = &wdev->tx_queues_stopped[ac];
+	int len = wfx_tx_queue_len(queue);
+
+	if (len >= queue->high_watermark && !test_bit(wvif->id, stopped)) {
+		spin_lock_bh(&wdev->tx_flow_lock);
+		if (wfx_tx_queue_len(queue) >= queue->high_watermark &&
+		    !test_and_set_bit(wvif->id, stopped))
+			ieee80211_stop_queue(wdev->hw, ac);
+		spin_unlock_bh(&wdev->tx_flow_lock);
+	} else if (len <= queue->low_watermark && test_bit(wvif->id, stopped)) {
+		spin_lock_bh(&wdev->tx_flow_lock);
+		if (wfx_tx_queue_len(queue) <= queue->low_watermark &&
+		    test_and_clear_bit(wvif->id, stopped) && !*stopped &&
+		    !wfx_tx_policy_cache_full(wdev))
+			ieee80211_wake_queue(wdev->hw, ac);
+		spin_unlock_bh(&wdev->tx_flow_lock);
+	}
+}
+
+/* Wake all the mac80211 queues, except the ones above their high watermark */
+void wfx_tx_queues_wake(struct wfx_dev *wdev)
+{
+	int i;
+
+	spin_lock_bh(&wdev->tx_flow_lock);
+	for (i = 0; i < IEEE80211_NUM_ACS; i++)
+		if (!wdev->tx_queues_stopped[i])
+			ieee80211_wake_queue(wdev->hw, i);
+	spin_unlock_bh(&wdev->tx_flow_lock);
+}
+
 bool wfx_tx_queue_empty(struct wfx_vif *wvif, struct wfx_queue *queue)
 {
 	return skb_queue_empty_lockless(&queue->normal) && skb_queue_empty_lockless(&queue->cab);
@@ -105,6 +200,7 @@ void wfx_tx_queue_drop(struct wfx_vif *wvif, struct wfx_queue *queue,
 {
 	__wfx_tx_queue_drop(wvif, &queue->cab, dropped);
 	__wfx_tx_queue_drop(wvif, &queue->normal, dropped);
+	wfx_tx_queue_update_flow(wvif, queue - wvif->tx_queue);
 	wake_up(&wvif->wdev->tx_dequeue);
 }
 
@@ -117,6 +213,59 @@ void wfx_tx_queues_put(struct wfx_vif *wvif, struct sk_buff *skb)
 		skb_queue_tail(&queue->cab, skb);
 	else
 		skb_queue_tail(&queue->normal, skb);
+	wfx_tx_queue_update_flow(wvif, skb_get_queue_mapping(skb));
+}
+
+/* Frames sent to the firmware are indexed by packet_id in an open addressing table. Since the
+ * lower bits of packet_id come from a counter, collisions are rare. The table is twice as large as
+ * the number of buffers of the firmware, so it is never full.
+ */
+int wfx_pending_init(struct wfx_dev *wdev)
+{
+	unsigned int size = roundup_pow_of_two(2 * le16_to_cpu(wdev->hw_caps.num_inp_ch_bufs));
+
+	wdev->tx_pending_slots = devm_kcalloc(wdev->dev, size, sizeof(*wdev->tx_pending_slots),
+					      GFP_KERNEL);
+	if (!wdev->tx_pending_slots)
+		return -ENOMEM;
+	wdev->tx_pending_mask = size - 1;
+	return 0;
+}
+
+static void wfx_pending_slot_insert(struct wfx_dev *wdev, struct sk_buff *skb)
+{
+	u32 packet_id = wfx_skb_txreq(skb)->packet_id;
+	unsigned int i, idx;
+
+	lockdep_assert_held(&wdev->tx_pending.lock);
+	for (i = 0; i <= wdev->tx_pending_mask; i++) {
+		idx = (packet_id + i) & wdev->tx_pending_mask;
+		if (!wdev->tx_pending_slots[idx]) {
+			wdev->tx_pending_slots[idx] = skb;
+			return;
+		}
+	}
+	WARN(1, "table of pending frames is full");
+}
+
+static void wfx_pending_slot_remove(struct wfx_dev *wdev, unsigned int hole)
+{
+	unsigned int mask = wdev->tx_pending_mask;
+	unsigned int idx, home;
+	struct sk_buff *skb;
+
+	lockdep_assert_held(&wdev->tx_pending.lock);
+	wdev->tx_pending_slots[hole] = NULL;
+	/* Shift back the following entries to keep the probe sequences unbroken */
+	for (idx = (hole + 1) & mask; wdev->tx_pending_slots[idx]; idx = (idx + 1) & mask) {
+		skb = wdev->tx_pending_slots[idx];
+		home = wfx_skb_txreq(skb)->packet_id & mask;
+		if (((idx - home) & mask) >= ((idx - hole) & mask)) {
+			wdev->tx_pending_slots[hole] = skb;
+			wdev->tx_pending_slots[idx] = NULL;
+			hole = idx;
+		}
+	}
 }
 
 void wfx_pending_drop(struct wfx_dev *wdev, struct sk_buff_head *dropped)
@@ -127,14 +276,17 @@ void wfx_pending_drop(struct wfx_dev *wdev, struct sk_buff_head *dropped)
 	struct sk_buff *skb;
 
 	WARN(!wdev->chip_frozen, "%s should only be used to recover a frozen device", __func__);
+	spin_lock_bh(&wdev->tx_pending.lock);
+	memset(wdev->tx_pending_slots, 0,
+	       (wdev->tx_pending_mask + 1) * sizeof(*wdev->tx_pending_slots));
+	spin_unlock_bh(&wdev->tx_pending.lock);
 	while ((skb = skb_dequeue(&wdev->tx_pending)) != NULL) {
 		hif = (struct wfx_hif_msg *)skb->data;
 		wvif = wdev_to_wvif(wdev, hif->interface);
 		if (wvif) {
-			queue = &wvif->tx_queue[skb_get_queue_mapping(skb)];
 			WARN_ON(skb_get_queue_mapping(skb) > 3);
-			WARN_ON(!atomic_read(&queue->pending_frames));
-			atomic_dec(&queue->pending_frames);
+			queue = &wvif->tx_queue[skb_get_queue_mapping(skb)];
+			wfx_tx_queue_sched_confirm(wdev, queue);
 		}
 		skb_queue_head(dropped, skb);
 	}
@@ -142,27 +294,32 @@ void wfx_pending_drop(struct wfx_dev *wdev, struct sk_buff_head *dropped)
 
 struct sk_buff *wfx_pending_get(struct wfx_dev *wdev, u32 packet_id)
 {
+	unsigned int mask = wdev->tx_pending_mask;
 	struct wfx_queue *queue;
-	struct wfx_hif_req_tx *req;
 	struct wfx_vif *wvif;
 	struct wfx_hif_msg *hif;
 	struct sk_buff *skb;
+	unsigned int i, idx;
 
 	spin_lock_bh(&wdev->tx_pending.lock);
-	skb_queue_walk(&wdev->tx_pending, skb) {
-		hif = (struct wfx_hif_msg *)skb->data;
-		req = (struct wfx_hif_req_tx *)hif->body;
-		if (req->packet_id != packet_id)
+	for (i = 0; i <= mask; i++) {
+		idx = (packet_id + i) & mask;
+		skb = wdev->tx_pending_slots[idx];
+		if (!skb)
+			break;
+		if (wfx_skb_txreq(skb)->packet_id != packet_id)
 			continue;
+		wfx_pending_slot_remove(wdev, idx);
+		__skb_unlink(skb, &wdev->tx_pending);
 		spin_unlock_bh(&wdev->tx_pending.lock);
+		wfx_skb_tx_priv(skb)->pending_lookups = min(i + 1, (unsigned int)U8_MAX);
+		hif = (struct wfx_hif_msg *)skb->data;
 		wvif = wdev_to_wvif(wdev, hif->interface);
 		if (wvif) {
-			queue = &wvif->tx_queue[skb_get_queue_mapping(skb)];
 			WARN_ON(skb_get_queue_mapping(skb) > 3);
-			WARN_ON(!atomic_read(&queue->pending_frames));
-			atomic_dec(&queue->pending_frames);
+			queue = &wvif->tx_queue[skb_get_queue_mapping(skb)];
+			wfx_tx_queue_sched_confirm(wdev, queue);
 		}
-		skb_unlink(skb, &wdev->tx_pending);
 		return skb;
 	}
 	spin_unlock_bh(&wdev->tx_pending.lock);
@@ -224,34 +381,139 @@ static int wfx_tx_queue_get_weight(struct wfx_queue *queue)
 	return atomic_read(&queue->pending_frames) * queue->priority;
 }
 
-static struct sk_buff *wfx_tx_queues_get_skb(struct wfx_dev *wdev)
+/* wdev->tx_sched contains the queues of all the vifs sorted by weight. Since the weight of a queue
+ * only changes by one step when a frame is sent or confirmed, moving this queue by a few positions
+ * is sufficient to keep the array sorted.
+ */
+static void wfx_tx_queue_sched_update(struct wfx_dev *wdev, struct wfx_queue *queue, int delta)
+{
+	struct wfx_queue **sched = wdev->tx_sched;
+	int i = queue->sched_idx;
+
+	lockdep_assert_held(&wdev->tx_sched_lock);
+	atomic_add(delta, &queue->pending_frames);
+	if (i < 0)
+		return;
+	while (i > 0 && wfx_tx_queue_get_weight(sched[i]) < wfx_tx_queue_get_weight(sched[i - 1])) {
+		swap(sched[i], sched[i - 1]);
+		sched[i]->sched_idx = i;
+		i--;
+	}
+	while (i < wdev->tx_sched_len - 1 &&
+	       wfx_tx_queue_get_weight(sched[i]) > wfx_tx_queue_get_weight(sched[i + 1])) {
+		swap(sched[i], sched[i + 1]);
+		sched[i]->sched_idx = i;
+		i++;
+	}
+	queue->sched_idx = i;
+}
+
+void wfx_tx_queue_sched_confirm(struct wfx_dev *wdev, struct wfx_queue *queue)
+{
+	spin_lock_bh(&wdev->tx_sched_lock);
+	WARN_ON(!atomic_read(&queue->pending_frames));
+	wfx_tx_queue_sched_update(wdev, queue, -1);
+	spin_unlock_bh(&wdev->tx_sched_lock);
+}
+
+/* Number of frames waiting in the driver queues (the frames still in the mac80211 TXQs are not
+ * counted).
+ */
+int wfx_tx_queues_get_backlog(struct wfx_dev *wdev)
 {
-	struct wfx_queue *queues[IEEE80211_NUM_ACS * ARRAY_SIZE(wdev->vif)];
-	int i, j, num_queues = 0;
+	int i, ret = 0;
+
+	spin_lock_bh(&wdev->tx_sched_lock);
+	for (i = 0; i < wdev->tx_sched_len; i++)
+		ret += wfx_tx_queue_len(wdev->tx_sched[i]);
+	spin_unlock_bh(&wdev->tx_sched_lock);
+	return ret;
+}
+
+/* Must be called each time a vif is added or removed */
+void wfx_tx_queues_sched_rebuild(struct wfx_dev *wdev)
+{
+	struct wfx_queue *queue;
 	struct wfx_vif *wvif;
-	struct wfx_hif_msg *hif;
-	struct sk_buff *skb;
+	int i, j;
 
-	/* sort the queues */
+	spin_lock_bh(&wdev->tx_sched_lock);
+	for (i = 0; i < wdev->tx_sched_len; i++)
+		wdev->tx_sched[i]->sched_idx = -1;
+	wdev->tx_sched_len = 0;
 	wvif = NULL;
 	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
 		for (i = 0; i < IEEE80211_NUM_ACS; i++) {
-			WARN_ON(num_queues >= ARRAY_SIZE(queues));
-			queues[num_queues] = &wvif->tx_queue[i];
-			for (j = num_queues; j > 0; j--)
-				if (wfx_tx_queue_get_weight(queues[j]) <
-				    wfx_tx_queue_get_weight(queues[j - 1]))
-					swap(queues[j - 1], queues[j]);
-			num_queues++;
+			queue = &wvif->tx_queue[i];
+			WARN_ON(wdev->tx_sched_len >= ARRAY_SIZE(wdev->tx_sched));
+			for (j = wdev->tx_sched_len; j > 0; j--) {
+				if (wfx_tx_queue_get_weight(wdev->tx_sched[j - 1]) <=
+				    wfx_tx_queue_get_weight(queue))
+					break;
+				wdev->tx_sched[j] = wdev->tx_sched[j - 1];
+				wdev->tx_sched[j]->sched_idx = j;
+			}
+			wdev->tx_sched[j] = queue;
+			queue->sched_idx = j;
+			wdev->tx_sched_len++;
 		}
 	}
+	spin_unlock_bh(&wdev->tx_sched_lock);
+}
+
+/* Expired frames are moved to the list expired. The queue is held while the retry policy of its
+ * first frame is not uploaded. In this case, blocked (if not NULL) is set.
+ */
+static struct sk_buff *wfx_tx_queue_dequeue(struct wfx_dev *wdev, struct wfx_queue *queue,
+					    struct sk_buff_head *skb_queue, ktime_t now,
+					    struct sk_buff_head *expired, bool *blocked)
+{
+	struct wfx_tx_priv *tx_priv;
+	struct sk_buff *skb;
+
+	spin_lock_bh(&skb_queue->lock);
+	while ((skb = skb_peek(skb_queue)) != NULL) {
+		tx_priv = wfx_skb_tx_priv(skb);
+		if (!tx_priv->deadline || ktime_before(now, tx_priv->deadline)) {
+			if (wfx_tx_policy_is_ready(wdev, skb)) {
+				__skb_unlink(skb, skb_queue);
+			} else {
+				if (blocked)
+					*blocked = true;
+				skb = NULL;
+			}
+			break;
+		}
+		__skb_unlink(skb, skb_queue);
+		atomic_inc(&queue->expired_drv);
+		__skb_queue_tail(expired, skb);
+	}
+	spin_unlock_bh(&skb_queue->lock);
+	return skb;
+}
 
+static struct sk_buff *wfx_tx_queues_get_skb(struct wfx_dev *wdev, ktime_t now,
+					     struct sk_buff_head *expired)
+{
+	struct wfx_queue *queue;
+	struct wfx_vif *wvif;
+	struct wfx_hif_msg *hif;
+	struct sk_buff *skb;
+	bool cab_blocked;
+	int i;
+
+	lockdep_assert_held(&wdev->tx_sched_lock);
 	wvif = NULL;
 	while ((wvif = wvif_iterate(wdev, wvif)) != NULL) {
 		if (!wvif->after_dtim_tx_allowed)
 			continue;
-		for (i = 0; i < num_queues; i++) {
-			skb = skb_dequeue(&queues[i]->cab);
+		cab_blocked = false;
+		for (i = 0; i < wdev->tx_sched_len; i++) {
+			queue = wdev->tx_sched[i];
+			if (skb_queue_empty_lockless(&queue->cab))
+				continue;
+			skb = wfx_tx_queue_dequeue(wdev, queue, &queue->cab, now, expired,
+						   &cab_blocked);
 			if (!skb)
 				continue;
 			/* Note: since only AP can have mcast frames in queue and only one vif can
@@ -259,40 +521,117 @@ static struct sk_buff *wfx_tx_queues_get_skb(struct wfx_dev *wdev)
 			 */
 			hif = (struct wfx_hif_msg *)skb->data;
 			WARN_ON(hif->interface != wvif->id);
-			WARN_ON(queues[i] != &wvif->tx_queue[skb_get_queue_mapping(skb)]);
-			atomic_inc(&queues[i]->pending_frames);
-			trace_queues_stats(wdev, queues[i]);
+			WARN_ON(queue != &wvif->tx_queue[skb_get_queue_mapping(skb)]);
+			wfx_tx_queue_sched_update(wdev, queue, 1);
+			wfx_tx_queue_update_flow(wvif, skb_get_queue_mapping(skb));
+			trace_queues_stats(wdev, queue);
 			return skb;
 		}
+		/* The bh runs again once the retry policy is uploaded */
+		if (cab_blocked)
+			continue;
 		/* No more multicast to sent */
 		wvif->after_dtim_tx_allowed = false;
 		schedule_work(&wvif->update_tim_work);
 	}
 
-	for (i = 0; i < num_queues; i++) {
-		skb = skb_dequeue(&queues[i]->normal);
+	for (i = 0; i < wdev->tx_sched_len; i++) {
+		queue = wdev->tx_sched[i];
+		if (skb_queue_empty_lockless(&queue->normal))
+			continue;
+		if (atomic_read(&queue->pending_frames) >= queue->pending_limit)
+			continue;
+		skb = wfx_tx_queue_dequeue(wdev, queue, &queue->normal, now, expired, NULL);
 		if (skb) {
-			atomic_inc(&queues[i]->pending_frames);
-			trace_queues_stats(wdev, queues[i]);
+			wfx_tx_queue_sched_update(wdev, queue, 1);
+			wvif = wdev_to_wvif(wdev, ((struct wfx_hif_msg *)skb->data)->interface);
+			if (wvif)
+				wfx_tx_queue_update_flow(wvif, skb_get_queue_mapping(skb));
+			trace_queues_stats(wdev, queue);
 			return skb;
 		}
 	}
 	return NULL;
 }
 
-struct wfx_hif_msg *wfx_tx_queues_get(struct wfx_dev *wdev)
+/* Frames sent on the same interface and queue, to the same peer */
+static bool wfx_tx_same_flow(struct sk_buff *skb1, struct sk_buff *skb2)
+{
+	struct wfx_hif_msg *hif1 = (struct wfx_hif_msg *)skb1->data;
+	struct wfx_hif_msg *hif2 = (struct wfx_hif_msg *)skb2->data;
+
+	return hif1->interface == hif2->interface &&
+	       skb_get_queue_mapping(skb1) == skb_get_queue_mapping(skb2) &&
+	       wfx_skb_txreq(skb1)->peer_sta_id == wfx_skb_txreq(skb2)->peer_sta_id;
+}
+
+/* Fill hifs with up to max frames. Return the number of frames retrieved. */
+int wfx_tx_queues_get(struct wfx_dev *wdev, struct wfx_hif_msg **hifs, int max)
 {
+	struct sk_buff *skbs[WFX_TX_BATCH_MAX];
+	struct sk_buff_head expired;
 	struct wfx_tx_priv *tx_priv;
+	struct wfx_hif_req_tx *req;
+	struct wfx_hif_msg *hif;
+	struct wfx_vif *wvif;
 	struct sk_buff *skb;
+	ktime_t now;
+	int i, j, num;
 
 	if (atomic_read(&wdev->tx_lock))
-		return NULL;
-	skb = wfx_tx_queues_get_skb(wdev);
-	if (!skb)
-		return NULL;
-	skb_queue_tail(&wdev->tx_pending, skb);
+		return 0;
+	__skb_queue_head_init(&expired);
+	now = ktime_get();
+	max = min_t(int, max, ARRAY_SIZE(skbs));
+	spin_lock_bh(&wdev->tx_sched_lock);
+	for (num = 0; num < max; num++) {
+		skbs[num] = wfx_tx_queues_get_skb(wdev, now, &expired);
+		if (!skbs[num])
+			break;
+	}
+	spin_unlock_bh(&wdev->tx_sched_lock);
+	if (!skb_queue_empty(&expired)) {
+		skb_queue_walk(&expired, skb) {
+			wvif = wdev_to_wvif(wdev, ((struct wfx_hif_msg *)skb->data)->interface);
+			if (wvif)
+				wfx_tx_queue_update_flow(wvif, skb_get_queue_mapping(skb));
+		}
+		wfx_tx_drop(wdev, &expired);
+	}
+	if (!num)
+		return 0;
+
+	/* Tell the firmware when other frames for the same peer and queue follow in this batch */
+	for (i = 0; i < num; i++) {
+		for (j = i + 1; j < num; j++)
+			if (wfx_tx_same_flow(skbs[i], skbs[j]))
+				break;
+		if (j == num)
+			continue;
+		wfx_skb_txreq(skbs[i])->more = 1;
+		hif = (struct wfx_hif_msg *)skbs[i]->data;
+		wvif = wdev_to_wvif(wdev, hif->interface);
+		if (wvif)
+			atomic_inc(&wvif->tx_queue[skb_get_queue_mapping(skbs[i])].tx_more);
+	}
+	for (i = 0; i < num; i++) {
+		tx_priv = wfx_skb_tx_priv(skbs[i]);
+		tx_priv->xmit_timestamp = now;
+		/* Give the remaining lifetime (in TUs) to the firmware */
+		if (tx_priv->deadline) {
+			req = wfx_skb_txreq(skbs[i]);
+			req->start_exp = 1;
+			req->expire_time = cpu_to_le32(max_t(s64, 1,
+				ktime_us_delta(tx_priv->deadline, now) / USEC_PER_TU));
+		}
+	}
+	spin_lock_bh(&wdev->tx_pending.lock);
+	for (i = 0; i < num; i++) {
+		__skb_queue_tail(&wdev->tx_pending, skbs[i]);
+		wfx_pending_slot_insert(wdev, skbs[i]);
+		hifs[i] = (struct wfx_hif_msg *)skbs[i]->data;
+	}
+	spin_unlock_bh(&wdev->tx_pending.lock);
 	wake_up(&wdev->tx_dequeue);
-	tx_priv = wfx_skb_tx_priv(skb);
-	tx_priv->xmit_timestamp = ktime_get();
-	return (struct wfx_hif_msg *)skb->data;
+	return num;
 }
@@ -19,8 +19,26 @@ struct wfx_queue {
 	struct sk_buff_head cab; /* Content After (DTIM) Beacon */
 	atomic_t            pending_frames;
 	int                 priority;
+	int                 sched_idx;
+	int                 high_watermark;
+	int                 low_watermark;
+	/* Frames sent to the firmware (but CAB) are limited to pending_limit */
+	unsigned int        delay_target; /* in us */
+	int                 pending_limit;
+	int                 pending_limit_max;
+	int                 pending_limit_credit;
+	atomic_t            expired_drv;
+	atomic_t            expired_fw;
+	atomic_t            tx_more;
+	atomic_t            cnf_aggr;
+	atomic_t            cnf_txop_limit;
 };
 
+#define WFX_TX_BATCH_MAX 16
+#define WFX_PENDING_LIMIT_MIN 2
+/* Maximum number of frames pulled from each mac80211 TXQ in advance (see high_watermark) */
+#define WFX_TXQ_DEPTH    WFX_TX_BATCH_MAX
+
 void wfx_tx_lock(struct wfx_dev *wdev);
 void wfx_tx_unlock(struct wfx_dev *wdev);
 void wfx_tx_flush(struct wfx_dev *wdev);
@@ -30,12 +48,19 @@ void wfx_tx_queues_init(struct wfx_vif *wvif);
 void wfx_tx_queues_check_empty(struct wfx_vif *wvif);
 bool wfx_tx_queues_has_cab(struct wfx_vif *wvif);
 void wfx_tx_queues_put(struct wfx_vif *wvif, struct sk_buff *skb);
-struct wfx_hif_msg *wfx_tx_queues_get(struct wfx_dev *wdev);
+void wfx_tx_queue_update_flow(struct wfx_vif *wvif, int ac);
+void wfx_tx_queue_update_limit(struct wfx_queue *queue, unsigned int tx_queue_delay);
+void wfx_tx_queues_wake(struct wfx_dev *wdev);
+int wfx_tx_queues_get(struct wfx_dev *wdev, struct wfx_hif_msg **hifs, int max);
+int wfx_tx_queues_get_backlog(struct wfx_dev *wdev);
+void wfx_tx_queues_sched_rebuild(struct wfx_dev *wdev);
+void wfx_tx_queue_sched_confirm(struct wfx_dev *wdev, struct wfx_queue *queue);
 
 bool wfx_tx_queue_empty(struct wfx_vif *wvif, struct wfx_queue *queue);
 void wfx_tx_queue_drop(struct wfx_vif *wvif, struct wfx_queue *queue,
 		       struct sk_buff_head *dropped);
 
+int wfx_pending_init(struct wfx_dev *wdev);
 struct sk_buff *wfx_pending_get(struct wfx_dev *wdev, u32 packet_id);
 void wfx_pending_drop(struct wfx_dev *wdev, struct sk_buff_head *dropped);
 unsigned int wfx_pending_get_pkt_us_delay(struct wfx_dev *wdev, struct sk_buff *skb);
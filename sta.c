@@ -15,6 +15,7 @@
 #include "key.h"
 #include "scan.h"
 #include "debug.h"
+#include "data_rx.h"
 #include "hif_tx.h"
 #include "hif_tx_mib.h"
 
@@ -147,6 +148,8 @@ void wfx_configure_filter(struct ieee80211_hw *hw, unsigned int changed_flags,
 
 		mutex_unlock(&wvif->scan_lock);
 	}
+	/* The filters are written asynchronously. Wait once for all of them. */
+	wfx_cmd_wait_idle(wdev);
 	mutex_unlock(&wdev->conf_mutex);
 }
 
@@ -288,6 +291,7 @@ void wfx_reset(struct wfx_vif *wvif)
 
 	wfx_tx_lock_flush(wdev);
 	wfx_hif_reset(wvif, false);
+	cancel_work_sync(&wvif->tx_policy_upload_work);
 	wfx_tx_policy_init(wvif);
 	if (wvif_count(wdev) <= 1)
 		wfx_hif_set_block_ack_policy(wvif, 0xFF, 0xFF);
@@ -317,6 +321,7 @@ int wfx_sta_add(struct ieee80211_hw *hw, struct ieee80211_vif *vif, struct ieee8
 	WARN_ON(!sta_priv->link_id);
 	WARN_ON(sta_priv->link_id >= HIF_LINK_ID_MAX);
 	wfx_hif_map_link(wvif, false, sta->addr, sta_priv->link_id, sta->mfp);
+	wfx_tx_policy_preload(wvif, sta);
 
 	return 0;
 }
@@ -394,6 +399,7 @@ int wfx_start_ap(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 	ret = wfx_hif_start(wvif, &vif->bss_conf, wvif->channel);
 	if (ret > 0)
 		return -EIO;
+	wfx_tx_policy_preload(wvif, NULL);
 	wfx_set_mfp_ap(wvif);
 	return ret;
 }
@@ -463,6 +469,8 @@ static void wfx_join_finalize(struct wfx_vif *wvif, struct ieee80211_bss_conf *i
 	rcu_read_lock(); /* protect sta */
 	if (info->bssid && !vif->cfg.ibss_joined)
 		sta = ieee80211_find_sta(vif, info->bssid);
+	if (sta)
+		wfx_tx_policy_preload(wvif, sta);
 	if (sta && sta->deflink.ht_cap.ht_supported)
 		ampdu_density = sta->deflink.ht_cap.ampdu_density;
 	if (sta && sta->deflink.ht_cap.ht_supported &&
@@ -508,6 +516,23 @@ static void wfx_enable_beacon(struct wfx_vif *wvif, bool enable)
 	wfx_hif_beacon_transmit(wvif, enable);
 }
 
+/* In firmware rate control mode, frames generated by the firmware use the lowest basic rate */
+static void wfx_set_internal_tx_rate(struct wfx_vif *wvif, u32 basic_rates)
+{
+	struct ieee80211_supported_band *band = wvif->wdev->hw->wiphy->bands[NL80211_BAND_2GHZ];
+	int rate, non_erp_rate;
+
+	if (!basic_rates)
+		return;
+	rate = band->bitrates[ffs(basic_rates) - 1].hw_value;
+	/* Lowest basic rate that is not a DSSS/CCK rate (4 first entries) */
+	if (basic_rates & ~GENMASK(3, 0))
+		non_erp_rate = band->bitrates[ffs(basic_rates & ~GENMASK(3, 0)) - 1].hw_value;
+	else
+		non_erp_rate = rate;
+	wfx_hif_set_internal_tx_rate(wvif, rate, non_erp_rate);
+}
+
 void wfx_bss_info_changed(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 			  struct ieee80211_bss_conf *info, u64 changed)
 {
@@ -524,6 +549,9 @@ void wfx_bss_info_changed(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 			wfx_join(wvif);
 	}
 
+	if (changed & BSS_CHANGED_BASIC_RATES && wdev->fw_rate_control)
+		wfx_set_internal_tx_rate(wvif, info->basic_rates);
+
 	if (changed & BSS_CHANGED_ASSOC) {
 		if (vif->cfg.assoc || vif->cfg.ibss_joined)
 			wfx_join_finalize(wvif, info);
@@ -578,6 +606,7 @@ void wfx_bss_info_changed(struct ieee80211_hw *hw, struct ieee80211_vif *vif,
 	if (changed & BSS_CHANGED_PS)
 		wfx_update_pm(wvif);
 
+	wfx_cmd_wait_idle(wdev);
 	mutex_unlock(&wdev->conf_mutex);
 }
 
@@ -758,8 +787,10 @@ int wfx_add_interface(struct ieee80211_hw *hw, struct ieee80211_vif *vif)
 		}
 	}
 	WARN(i == ARRAY_SIZE(wdev->vif), "try to instantiate more vif than supported");
+	wfx_tx_queues_sched_rebuild(wdev);
 
 	wfx_hif_set_macaddr(wvif, vif->addr);
+	wfx_tx_lifetime_apply(wvif);
 
 	mutex_unlock(&wdev->conf_mutex);
 
@@ -787,10 +818,12 @@ void wfx_remove_interface(struct ieee80211_hw *hw, struct ieee80211_vif *vif)
 
 	wfx_hif_reset(wvif, false);
 	wfx_hif_set_macaddr(wvif, NULL);
+	cancel_work_sync(&wvif->tx_policy_upload_work);
 	wfx_tx_policy_init(wvif);
 
 	cancel_delayed_work_sync(&wvif->beacon_loss_work);
 	wdev->vif[wvif->id] = NULL;
+	wfx_tx_queues_sched_rebuild(wdev);
 
 	mutex_unlock(&wdev->conf_mutex);
 
@@ -806,6 +839,9 @@ void wfx_remove_interface(struct ieee80211_hw *hw, struct ieee80211_vif *vif)
 
 int wfx_start(struct ieee80211_hw *hw)
 {
+	struct wfx_dev *wdev = hw->priv;
+
+	wfx_rx_napi_start(wdev);
 	return 0;
 }
 
@@ -813,5 +849,6 @@ void wfx_stop(struct ieee80211_hw *hw)
 {
 	struct wfx_dev *wdev = hw->priv;
 
+	wfx_rx_napi_stop(wdev);
 	WARN_ON(!skb_queue_empty_lockless(&wdev->tx_pending));
 }
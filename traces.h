@@ -360,12 +360,38 @@ TRACE_EVENT(bh_stats,
 #define _trace_bh_stats(ind, req, cnf, busy, release)\
 	trace_bh_stats(ind, req, cnf, busy, release)
 
+TRACE_EVENT(bh_loop,
+	TP_PROTO(int max_tx, int max_rx, int num_tx, int num_rx),
+	TP_ARGS(max_tx, max_rx, num_tx, num_rx),
+	TP_STRUCT__entry(
+		__field(int, max_tx)
+		__field(int, max_rx)
+		__field(int, num_tx)
+		__field(int, num_rx)
+	),
+	TP_fast_assign(
+		__entry->max_tx = max_tx;
+		__entry->max_rx = max_rx;
+		__entry->num_tx = num_tx;
+		__entry->num_rx = num_rx;
+	),
+	TP_printk("REQ:%3d/%3d, IND:%3d/%3d",
+		__entry->num_tx,
+		__entry->max_tx,
+		__entry->num_rx,
+		__entry->max_rx
+	)
+);
+#define _trace_bh_loop(max_tx, max_rx, num_tx, num_rx)\
+	trace_bh_loop(max_tx, max_rx, num_tx, num_rx)
+
 TRACE_EVENT(tx_stats,
 	TP_PROTO(const struct wfx_hif_cnf_tx *tx_cnf, const struct sk_buff *skb,
-		 int delay),
-	TP_ARGS(tx_cnf, skb, delay),
+		 int delay, int lookups),
+	TP_ARGS(tx_cnf, skb, delay, lookups),
 	TP_STRUCT__entry(
 		__field(int, pkt_id)
+		__field(int, lookups)
 		__field(int, delay_media)
 		__field(int, delay_queue)
 		__field(int, delay_fw)
@@ -386,6 +412,7 @@ TRACE_EVENT(tx_stats,
 		__entry->delay_media = le32_to_cpu(tx_cnf->media_delay);
 		__entry->delay_queue = le32_to_cpu(tx_cnf->tx_queue_delay);
 		__entry->delay_fw = delay;
+		__entry->lookups = lookups;
 		__entry->ack_failures = tx_cnf->ack_failures;
 		if (!tx_cnf->status || __entry->ack_failures)
 			__entry->ack_failures += 1;
@@ -412,12 +439,20 @@ TRACE_EVENT(tx_stats,
 			__entry->flags |= 0x20;
 		if (tx_cnf->status == HIF_STATUS_TX_FAIL_REQUEUE)
 			__entry->flags |= 0x40;
+		if (((const struct wfx_hif_req_tx *)
+		     ((const struct wfx_hif_msg *)skb->data)->body)->more)
+			__entry->flags |= 0x80;
+		if (tx_cnf->aggr)
+			__entry->flags |= 0x100;
+		if (tx_cnf->txop_limit)
+			__entry->flags |= 0x200;
 	),
-	TP_printk("packet ID: %08x, rate policy: %s %d|%d %d|%d %d|%d %d|%d -> %d attempt, Delays media/queue/total: %4dus/%4dus/%4dus",
+	TP_printk("packet ID: %08x, rate policy: %s %d|%d %d|%d %d|%d %d|%d -> %d attempt, Delays media/queue/total: %4dus/%4dus/%4dus, lookups: %d",
 		__entry->pkt_id,
 		__print_flags(__entry->flags, NULL,
 			{ 0x01, "M" }, { 0x02, "S" }, { 0x04, "G" }, { 0x08, "R" },
-			{ 0x10, "D" }, { 0x20, "F" }, { 0x40, "Q" }),
+			{ 0x10, "D" }, { 0x20, "F" }, { 0x40, "Q" }, { 0x80, "B" },
+			{ 0x100, "A" }, { 0x200, "T" }),
 		__entry->rate[0],
 		__entry->tx_count[0],
 		__entry->rate[1],
@@ -429,10 +464,12 @@ TRACE_EVENT(tx_stats,
 		__entry->ack_failures,
 		__entry->delay_media,
 		__entry->delay_queue,
-		__entry->delay_fw
+		__entry->delay_fw,
+		__entry->lookups
 	)
 );
-#define _trace_tx_stats(tx_cnf, skb, delay) trace_tx_stats(tx_cnf, skb, delay)
+#define _trace_tx_stats(tx_cnf, skb, delay, lookups) \
+	trace_tx_stats(tx_cnf, skb, delay, lookups)
 
 TRACE_EVENT(queues_stats,
 	TP_PROTO(struct wfx_dev *wdev, const struct wfx_queue *elected_queue),
@@ -14,6 +14,7 @@
 #include <linux/workqueue.h>
 #include <linux/mutex.h>
 #include <linux/nospec.h>
+#include <linux/netdevice.h>
 #include <net/mac80211.h>
 
 #include "bh.h"
@@ -21,6 +22,7 @@
 #include "main.h"
 #include "queue.h"
 #include "hif_tx.h"
+#include "fwio.h"
 
 #define USEC_PER_TXOP 32 /* see struct ieee80211_tx_queue_params */
 #define USEC_PER_TU 1024
@@ -42,17 +44,55 @@ struct wfx_dev {
 	struct wfx_hif             hif;
 	struct delayed_work        cooling_timeout_work;
 	bool                       poll_irq;
+	bool                       bh_in_irq;
+	bool                       bh_thread;
+	const char                 *bh_thread_policy;
+	int                        bh_thread_nice;
+	const char                 *bh_thread_cpus;
+	unsigned int               bh_poll_max_us;
+	u32                        keep_awake_ms;
+	bool                       calibrate_bus;
+	struct wfx_bus_calib       bus_calib[WFX_BUS_CALIB_NUM];
+	struct task_struct         *bus_session_owner; /* see wfx_bus_session_start() */
+	ktime_t                    bus_session_start;
+	u32                        bus_sessions;
+	u32                        bus_session_yields;
+	u32                        bus_session_xfers;
+	u32                        tx_copy_room; /* see wfx_tx_make_room() */
+	u32                        tx_copy_nonlinear;
+	bool                       fw_rate_control;
 	bool                       chip_frozen;
 	struct mutex               conf_mutex;
 
 	struct wfx_hif_cmd         hif_cmd;
+	struct wfx_hif_mib_cache   mib_cache;
+	struct wfx_queue           *tx_sched[IEEE80211_NUM_ACS * 2];
+	int                        tx_sched_len;
+	spinlock_t                 tx_sched_lock;
+	unsigned long              tx_queues_stopped[IEEE80211_NUM_ACS];
+	spinlock_t                 tx_flow_lock;
 	struct sk_buff_head        tx_pending;
+	struct sk_buff             **tx_pending_slots;
+	unsigned int               tx_pending_mask;
 	wait_queue_head_t          tx_dequeue;
 	atomic_t                   tx_lock;
 
 	atomic_t                   packet_id;
+	/* Lifetime of the frames for each AC (in ms, 0 means unlimited) */
+	u32                        tx_lifetime[IEEE80211_NUM_ACS];
 	u32                        key_map;
 
+	/* mac80211 is not bound to a net_device, so the NAPI context uses a dummy one */
+	struct net_device          napi_dev;
+	struct napi_struct         rx_napi;
+	struct sk_buff_head        rx_napi_queue;
+	u64                        rx_napi_frames;
+	u64                        rx_napi_bytes;
+	u64                        rx_napi_time_ns; /* spent in wfx_rx_napi_poll() */
+	unsigned int               rx_napi_polls;
+	unsigned int               rx_napi_budget_exhausted;
+	unsigned int               rx_napi_drops;
+
 	struct wfx_hif_rx_stats    rx_stats;
 	struct mutex               rx_stats_lock;
 	struct wfx_hif_tx_power_loop_info tx_power_loop_info;
@@ -73,6 +113,7 @@ struct wfx_vif {
 	struct delayed_work        beacon_loss_work;
 
 	struct wfx_queue           tx_queue[4];
+	bool                       tx_lifetime_mib; /* see wfx_tx_lifetime_apply() */
 	struct wfx_tx_policy_cache tx_policy_cache;
 	struct work_struct         tx_policy_upload_work;
 